@@ -7,6 +7,7 @@
 #include <QDir>
 #include <QFileInfo>
 #include <QThread>
+#include <QThreadStorage>
 
 namespace {
     inline bool execWarn(QSqlQuery& q) {
@@ -23,6 +24,8 @@ namespace {
 
 DBManager::DBManager(QObject* parent) : QObject(parent) {}
 
+DBManager::~DBManager() { close(); }
+
 //открытие и подготовка файла БД 
 bool DBManager::open(const QString& dbPath) {
     QString finalPath = dbPath;
@@ -31,20 +34,44 @@ bool DBManager::open(const QString& dbPath) {
         // создаём путь рядом с исполняемым
         finalPath = QDir(QCoreApplication::applicationDirPath()).filePath(dbPath);
     }
-    const QString connName =
-        QString::fromLatin1("app_%1").arg(quintptr(QThread::currentThreadId()));
+    const QString connName = // своё подключение на поток и объект (шарды открываются параллельно)
+        QString::fromLatin1("app_%1_%2").arg(quintptr(QThread::currentThreadId())).arg(quintptr(this));
     m_db = QSqlDatabase::contains(connName) // переиспользуем подключение "app", если уже есть
         ? QSqlDatabase::database(connName)
         : QSqlDatabase::addDatabase("QSQLITE", connName); // иначе создаём новое подключение SQLite
 
     m_db.setDatabaseName(finalPath); // файл БД (создастся при первом открытии)
     if (!m_db.open()) { qWarning() << "SQLite open error:" << m_db.lastError(); return false; }
+    m_cache = SearchCache::forDatabase(finalPath); // кэш поиска для этого файла БД
 
     QSqlQuery pragma(m_db); // запрос для PRAGMA
     pragma.exec("PRAGMA foreign_keys = ON;"); // включаем внешние ключи 
+    pragma.exec("PRAGMA auto_vacuum = INCREMENTAL;"); // действует только на новый файл, до первой таблицы
+    pragma.exec("PRAGMA journal_mode = WAL;"); // поиск читает, пока идёт запись или вакуум
     return ensureSchema();
 }
 
+DBManager* DBManager::threadLocal(const QString& dbPath) {
+    // уничтожается при выходе потока — вместе с подключениями (см. ~DBManager)
+    static QThreadStorage<QHash<QString, QSharedPointer<DBManager>>> connections;
+    QHash<QString, QSharedPointer<DBManager>>& byPath = connections.localData();
+
+    QSharedPointer<DBManager> db = byPath.value(dbPath);
+    if (db) return db.data();
+    db.reset(new DBManager);
+    if (!db->open(dbPath)) return nullptr; // не запоминаем: шард мог ещё не появиться
+    byPath.insert(dbPath, db);
+    return db.data();
+}
+
+void DBManager::close() {
+    const QString connName = m_db.connectionName();
+    if (connName.isEmpty()) return;
+    m_db.close();
+    m_db = QSqlDatabase(); // копий подключения не должно остаться до removeDatabase
+    QSqlDatabase::removeDatabase(connName);
+}
+
 //создание таблиц
 bool DBManager::ensureSchema() {
     QSqlQuery q(m_db);
@@ -55,8 +82,14 @@ bool DBManager::ensureSchema() {
         " path TEXT NOT NULL UNIQUE,"
         " size INTEGER,"
         " modified TEXT,"
-        " line_count INTEGER)"
+        " line_count INTEGER,"
+        " min_time TEXT,"
+        " max_time TEXT,"
+        " codec TEXT)"
     ); if (!execWarn(q)) return false;
+    if (!ensureColumn("Files", "min_time", "TEXT")) return false; // индексы до появления времени
+    if (!ensureColumn("Files", "max_time", "TEXT")) return false;
+    if (!ensureColumn("Files", "codec", "TEXT")) return false; // NULL — старый индекс, UTF-8
 
     q.prepare( // таблица Words: уникальное слово и его общий счётчик
         "CREATE TABLE IF NOT EXISTS Words (" 
@@ -74,40 +107,69 @@ bool DBManager::ensureSchema() {
         " FOREIGN KEY(word_id) REFERENCES Words(id) ON DELETE CASCADE,"
         " FOREIGN KEY(file_id) REFERENCES Files(id) ON DELETE CASCADE)"
     ); if (!execWarn(q)) return false;
+    // постинги файла: переиндексация и каскадное удаление без полного просмотра таблицы
+    q.prepare("CREATE INDEX IF NOT EXISTS idx_wordindex_file ON WordIndex(file_id)");
+    if (!execWarn(q)) return false;
+
+    q.prepare( // таблица TimeCheckpoints: редкие отметки времени по строкам файла
+        "CREATE TABLE IF NOT EXISTS TimeCheckpoints ("
+        " file_id INTEGER NOT NULL,"
+        " line INTEGER NOT NULL,"
+        " ts TEXT NOT NULL,"
+        " PRIMARY KEY(file_id, line),"
+        " FOREIGN KEY(file_id) REFERENCES Files(id) ON DELETE CASCADE)"
+    ); if (!execWarn(q)) return false;
 
     return true;
 }
 
-//очистка трех таблиц
+bool DBManager::ensureColumn(const char* table, const char* col, const char* type) {
+    QSqlQuery q(m_db);
+    if (!q.exec(QString("PRAGMA table_info(%1)").arg(table))) { qWarning() << q.lastError(); return false; }
+    while (q.next())
+        if (q.value(1).toString() == QLatin1String(col)) return true; // колонка уже есть
+
+    if (!q.exec(QString("ALTER TABLE %1 ADD COLUMN %2 %3").arg(table, col, type))) {
+        qWarning() << q.lastError(); return false;
+    }
+    return true;
+}
+
+//очистка таблиц
 bool DBManager::clearAll() {
     QSqlQuery q(m_db);
+    q.prepare("DELETE FROM TimeCheckpoints"); if (!execWarn(q)) return false;
     q.prepare("DELETE FROM WordIndex"); if (!execWarn(q)) return false;
     q.prepare("DELETE FROM Words");     if (!execWarn(q)) return false;
     q.prepare("DELETE FROM Files");     if (!execWarn(q)) return false;
+    if (m_cache) m_cache->clear();
+    if (isIncrementalVacuum()) vacuumStep(freePages()); // сразу отдаём место ОС
     return true;
 }
 
 
 int DBManager::upsertFile(const QString& path, qint64 size,
-    const QDateTime& modified, int lineCount) {
+    const QDateTime& modified, int lineCount, const QByteArray& codec) {
     int id = selectId("Files", "path", path); // пытаемся найти существующую запись
     QSqlQuery q(m_db);
 
     if (id < 0) { // // если нет — INSERT
-        q.prepare("INSERT INTO Files(path,size,modified,line_count)"
-            " VALUES(:p,:s,:m,:lc)");
+        q.prepare("INSERT INTO Files(path,size,modified,line_count,codec)"
+            " VALUES(:p,:s,:m,:lc,:c)");
         q.bindValue(":p", path); // связываем параметры (path, size, modified, lineCount)
         q.bindValue(":s", size);
         q.bindValue(":m", modified.toString(Qt::ISODate));
         q.bindValue(":lc", lineCount);
+        q.bindValue(":c", QString::fromLatin1(codec));
         if (!execWarn(q)) return -1; // при ошибке - лог и -1
         return q.lastInsertId().toInt(); // возвращаем новый id
     }
 
-    q.prepare("UPDATE Files SET size=:s, modified=:m, line_count=:lc WHERE id=:id"); // иначе — UPDATE
+    q.prepare("UPDATE Files SET size=:s, modified=:m, line_count=:lc, codec=:c WHERE id=:id"); // иначе — UPDATE
     q.bindValue(":s", size);
     q.bindValue(":m", modified.toString(Qt::ISODate));
     q.bindValue(":lc", lineCount);
+    q.bindValue(":c", QString::fromLatin1(codec));
     q.bindValue(":id", id);
     execWarn(q); // обновляем
     return id; // возвращаем существующий id
@@ -142,6 +204,56 @@ bool DBManager::upsertWordIndex(int wordId, int fileId, const QVector<int>& line
     return execWarn(q);
 }
 
+bool DBManager::setTimeIndex(int fileId, const QDateTime& minTime, const QDateTime& maxTime,
+    const QVector<TimeCheckpoint>& checkpoints)
+{
+    QSqlQuery q(m_db);
+    q.prepare("UPDATE Files SET min_time=:mn, max_time=:mx WHERE id=:id"); // NULL — в файле нет времени
+    q.bindValue(":mn", minTime.isValid() ? QVariant(timeKey(minTime)) : QVariant(QVariant::String));
+    q.bindValue(":mx", maxTime.isValid() ? QVariant(timeKey(maxTime)) : QVariant(QVariant::String));
+    q.bindValue(":id", fileId);
+    if (!execWarn(q)) return false;
+
+    q.prepare("DELETE FROM TimeCheckpoints WHERE file_id=:id"); // старые точки при переиндексации
+    q.bindValue(":id", fileId);
+    if (!execWarn(q)) return false;
+
+    q.prepare("INSERT INTO TimeCheckpoints(file_id,line,ts) VALUES(:f,:l,:t)");
+    for (const TimeCheckpoint& cp : checkpoints) {
+        q.bindValue(":f", fileId);
+        q.bindValue(":l", cp.first);
+        q.bindValue(":t", timeKey(cp.second));
+        if (!execWarn(q)) return false;
+    }
+    return true;
+}
+
+int DBManager::findWord(const QString& word) const {
+    return selectId("Words", "word", word);
+}
+
+// файлы из индекса, лежащие внутри директории
+QHash<QString, int> DBManager::filesUnder(const QString& dirPath) const {
+    QHash<QString, int> out;
+    QString prefix = QDir::fromNativeSeparators(dirPath);
+    if (!prefix.endsWith('/')) prefix += '/';
+
+    QSqlQuery q(m_db);
+    q.prepare("SELECT id, path FROM Files WHERE instr(path, :d) = 1");
+    q.bindValue(":d", prefix);
+    if (!execWarn(q)) return out;
+    while (q.next()) out.insert(q.value(1).toString(), q.value(0).toInt());
+    return out;
+}
+
+bool DBManager::removeFile(int fileId) {
+    if (!clearFileIndex(fileId)) return false; // иначе каскад оставит счётчики слов завышенными
+    QSqlQuery q(m_db);
+    q.prepare("DELETE FROM Files WHERE id=:id");
+    q.bindValue(":id", fileId);
+    return execWarn(q);
+}
+
 int DBManager::selectId(const char* table, const char* col, const QString& value) const {
     QSqlQuery q(m_db);
     q.prepare(QString("SELECT id FROM %1 WHERE %2 = :v").arg(table, col));
@@ -149,3 +261,105 @@ int DBManager::selectId(const char* table, const char* col, const QString& value
     if (!q.exec()) return -1;
     return q.next() ? q.value(0).toInt() : -1;
 }
+
+bool DBManager::clearFileIndex(int fileId) {
+    QSqlQuery q(m_db);
+    q.prepare( // число строк в списке = запятые + 1
+        "UPDATE Words SET occurrences = occurrences - ("
+        " SELECT length(wi.line_numbers) - length(replace(wi.line_numbers, ',', '')) + 1"
+        " FROM WordIndex wi WHERE wi.word_id = Words.id AND wi.file_id = :f)"
+        " WHERE id IN (SELECT word_id FROM WordIndex WHERE file_id = :f2)");
+    q.bindValue(":f", fileId);
+    q.bindValue(":f2", fileId);
+    if (!execWarn(q)) return false;
+
+    q.prepare("DELETE FROM WordIndex WHERE file_id = :f");
+    q.bindValue(":f", fileId);
+    return execWarn(q);
+}
+
+int DBManager::removeOrphanWords(int fromId, int toId) {
+    QSqlQuery q(m_db);
+    q.prepare(
+        "DELETE FROM Words WHERE id > :lo AND id <= :hi"
+        " AND NOT EXISTS (SELECT 1 FROM WordIndex wi WHERE wi.word_id = Words.id)");
+    q.bindValue(":lo", fromId);
+    q.bindValue(":hi", toId);
+    if (!execWarn(q)) return -1;
+    return q.numRowsAffected();
+}
+
+int DBManager::repairOccurrences(int fromId, int toId) {
+    QSqlQuery q(m_db);
+    // пишем только разошедшиеся счётчики: меньше страниц в WAL
+    q.prepare(
+        "UPDATE Words SET occurrences = ("
+        " SELECT COALESCE(SUM(length(line_numbers) - length(replace(line_numbers, ',', '')) + 1), 0)"
+        " FROM WordIndex WHERE word_id = Words.id)"
+        " WHERE id > :lo AND id <= :hi AND occurrences IS NOT ("
+        " SELECT COALESCE(SUM(length(line_numbers) - length(replace(line_numbers, ',', '')) + 1), 0)"
+        " FROM WordIndex WHERE word_id = Words.id)");
+    q.bindValue(":lo", fromId);
+    q.bindValue(":hi", toId);
+    if (!execWarn(q)) return -1;
+    return q.numRowsAffected();
+}
+
+int DBManager::maxWordId() const {
+    QSqlQuery q(m_db);
+    if (!q.exec("SELECT COALESCE(MAX(id), 0) FROM Words") || !q.next()) return 0;
+    return q.value(0).toInt();
+}
+
+qint64 DBManager::pragmaValue(const char* name) const {
+    QSqlQuery q(m_db);
+    if (!q.exec(QString("PRAGMA %1").arg(name)) || !q.next()) return -1;
+    return q.value(0).toLongLong();
+}
+
+bool DBManager::isIncrementalVacuum() const { return pragmaValue("auto_vacuum") == 2; }
+
+int DBManager::freePages() const { return int(pragmaValue("freelist_count")); }
+
+qint64 DBManager::sizeBytes() const {
+    return pragmaValue("page_count") * pragmaValue("page_size");
+}
+
+bool DBManager::enableIncrementalVacuum() {
+    QSqlQuery q(m_db);
+    // режим auto_vacuum существующего файла меняется только полным VACUUM
+    if (!q.exec("PRAGMA auto_vacuum = INCREMENTAL") || !q.exec("VACUUM")) {
+        qWarning() << q.lastError(); return false;
+    }
+    return isIncrementalVacuum();
+}
+
+bool DBManager::vacuumStep(int pages) {
+    // QSQLite делает один шаг запроса, а incremental_vacuum освобождает страницу за шаг:
+    // повторяем PRAGMA до цели, но в одной транзакции — одна фиксация на весь срез
+    const int target = qMax(0, freePages() - pages);
+    if (!m_db.transaction()) { qWarning() << m_db.lastError(); return false; }
+    QSqlQuery q(m_db);
+    for (int left = freePages(); left > target; ) {
+        if (!q.exec(QString("PRAGMA incremental_vacuum(%1)").arg(left - target))) {
+            qWarning() << q.lastError(); m_db.rollback(); return false;
+        }
+        while (q.next()) {}
+        const int now = freePages();
+        if (now >= left) break; // файл не в режиме INCREMENTAL
+        left = now;
+    }
+    return m_db.commit();
+}
+
+void DBManager::optimize() {
+    QSqlQuery q(m_db);
+    q.exec("PRAGMA optimize");
+    q.exec("PRAGMA wal_checkpoint(TRUNCATE)"); // без этого место вернётся ОС только при закрытии
+}
+
+bool DBManager::leaveWal() {
+    QSqlQuery q(m_db);
+    if (!q.exec("PRAGMA journal_mode = DELETE")) { qWarning() << q.lastError(); return false; } // со сбросом WAL
+    return true;
+}
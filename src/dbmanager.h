@@ -4,28 +4,67 @@
 #include <QDateTime>
 #include <QString>
 #include <QVector>
+#include <QHash>
+#include <QSharedPointer>
+#include "searchcache.h"
+#include "timeindex.h"
 
 class DBManager : public QObject {
     Q_OBJECT
 public:
     explicit DBManager(QObject* parent = nullptr);
+    ~DBManager();
 
     bool open(const QString& dbPath = "index.db");
+    void close(); // закрывает и удаляет подключение этого объекта
+
+    // подключение текущего потока к файлу БД: открывается при первом обращении
+    // и живёт до выхода потока (схема проверяется один раз, а не на каждый запрос).
+    // Не удалять и не передавать в другие потоки; nullptr — не открылась
+    static DBManager* threadLocal(const QString& dbPath);
     bool clearAll();
 
     // создаёт таблицы при первом запуске
     bool ensureSchema();
 
     int  upsertFile(const QString& path, qint64 size,
-        const QDateTime& modified, int lineCount);
+        const QDateTime& modified, int lineCount,
+        const QByteArray& codec = QByteArray()); // кодировка, в которой файл читался при индексации
     int  upsertWord(const QString& wordLower, int addOccurrences);
     bool upsertWordIndex(int wordId, int fileId, const QVector<int>& lines);
+    // границы времени записей файла и редкие контрольные точки время -> строка
+    bool setTimeIndex(int fileId, const QDateTime& minTime, const QDateTime& maxTime,
+        const QVector<TimeCheckpoint>& checkpoints);
+
+    int  findWord(const QString& word) const;
+    QHash<QString, int> filesUnder(const QString& dirPath) const; // путь -> id
+    bool removeFile(int fileId); // WordIndex чистится каскадом
+    // снимает старые постинги файла перед переиндексацией и вычитает их из счётчиков слов
+    bool clearFileIndex(int fileId);
+
+    // обслуживание (см. IndexMaintenance); каждый вызов — отдельная короткая транзакция
+    // обе работают по диапазону id слов (fromId, toId] и возвращают число затронутых строк
+    int  removeOrphanWords(int fromId, int toId); // слова без постингов
+    int  repairOccurrences(int fromId, int toId); // пересчёт счётчиков по WordIndex
+    int  maxWordId() const;
+    bool isIncrementalVacuum() const;
+    bool enableIncrementalVacuum(); // перевод старой БД: полный VACUUM, файл блокируется
+    bool vacuumStep(int pages);     // вернуть ОС до pages свободных страниц одной транзакцией
+    int  freePages() const;
+    qint64 sizeBytes() const;       // page_count * page_size
+    void optimize();                // PRAGMA optimize и сброс WAL в основной файл
+    bool leaveWal();                // WAL -> основной файл и обычный журнал (БД без -wal/-shm)
 
     QSqlDatabase database() const { return m_db; }
+    QSharedPointer<SearchCache> cache() const { return m_cache; }
 
 private:
     QSqlDatabase m_db;
+    QSharedPointer<SearchCache> m_cache; // общий для всех подключений к этому файлу
 
     // общий селект id по строковому полю
     int  selectId(const char* table, const char* col, const QString& value) const;
+    qint64 pragmaValue(const char* name) const; // значение PRAGMA без аргументов
+    // миграция старых БД: добавляет колонку, если её ещё нет
+    bool ensureColumn(const char* table, const char* col, const char* type);
 };
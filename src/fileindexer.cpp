@@ -1,14 +1,17 @@
 #include "fileindexer.h"
+#include "utils.h"
 #include <QDirIterator>
 #include <QFile>
-#include <QTextStream>
 #include <QFileInfo>
 #include <QRegularExpression>
+#include <QSet>
+#include <QFuture>
+#include <QtConcurrent/QtConcurrentRun>
 #include <algorithm>
 
 
-FileIndexer::FileIndexer(DBManager* db, QObject* parent)
-    : QObject(parent), m_db(db) {
+FileIndexer::FileIndexer(ShardSet* shards, QObject* parent)
+    : QObject(parent), m_shards(shards) {
 }
 
 // скан директории 
@@ -22,36 +25,119 @@ void FileIndexer::scanDirectory(const QString& dirPath,
     while (counter.hasNext())
         allFiles << counter.next();
 
-    int total = allFiles.size();
-    if (total == 0) {
-        emit scanFinished();
-        return;
+    // раскладываем файлы по шардам
+    QHash<QString, QStringList> byShard; // путь к БД шарда -> файлы
+    for (const QString& file : allFiles) {
+        const Shard s = m_shards->shardFor(file);
+        if (s.isValid()) byShard[s.dbPath] << file;
+    }
+    const QSet<QString> present(allFiles.cbegin(), allFiles.cend());
+
+    const int total = allFiles.size();
+    if (total > 0)
+        emit scanStarted(total); // сообщаем GUI, сколько всего файлов
+
+    // шарды — независимые файлы SQLite, поэтому пишем в них параллельно
+    QAtomicInt current(0);
+    QVector<QFuture<void>> tasks;
+    for (const Shard& s : m_shards->shards()) {
+        const QStringList files = byShard.value(s.dbPath);
+        tasks << QtConcurrent::run([this, s, files, &dirPath, &present, &codec, &current, total]() {
+            indexShard(s, dirPath, present, files, codec, current, total);
+        });
     }
+    for (QFuture<void>& t : tasks) t.waitForFinished();
 
-    emit scanStarted(total); // сообщаем GUI, сколько всего файлов
+    emit scanFinished(); // сообщаем о завершении
+}
 
-    int current = 0;
-    for (const QString& file : allFiles) {
-        processFile(file, codec);
-        emit progressChanged(++current, total); // обновляем прогресс
+// индексация одного шарда
+void FileIndexer::indexShard(const Shard& shard, const QString& dirPath,
+    const QSet<QString>& present, const QStringList& files,
+    const QByteArray& codec, QAtomicInt& current, int total)
+{
+    static const int kFilesPerCommit = 100; // поиск видит новые данные порциями
+
+    DBManager db; // подключение живёт только в этом потоке
+    if (!db.open(shard.dbPath)) {
+        emit progressChanged(current.fetchAndAddRelaxed(files.size()) + files.size(), total);
+        return;
+    }
+    db.database().transaction();
+    Touched touched; // что сбросить в кэше после фиксации порции
+
+    // убираем из индекса файлы, которых больше нет на диске, и файлы,
+    // переехавшие в другой шард (например, после подключения шарда с корнем)
+    const QHash<QString, int> known = db.filesUnder(dirPath);
+    for (auto it = known.cbegin(); it != known.cend(); ++it) {
+        if (present.contains(it.key()) && m_shards->shardFor(it.key()).dbPath == shard.dbPath) continue;
+        if (db.removeFile(it.value())) touched.files.insert(it.value());
+    }
+    commitBatch(db, touched);
+
+    int inBatch = 0;
+    for (const QString& file : files) {
+        processFile(&db, file, codec, m_timeParser, touched);
+        emit progressChanged(current.fetchAndAddRelaxed(1) + 1, total); // обновляем прогресс
+        if (++inBatch == kFilesPerCommit) {
+            commitBatch(db, touched);
+            inBatch = 0;
+        }
     }
+    db.database().commit();
+    flushCache(db, touched);
+}
 
-    emit scanFinished(); // сообщаем о завершении
+// фиксация порции и новая транзакция
+void FileIndexer::commitBatch(DBManager& db, Touched& touched) {
+    db.database().commit();
+    flushCache(db, touched);
+    db.database().transaction();
+}
+
+// кэш сбрасываем только после commit: до него другие подключения видят старые данные
+// и положили бы их в кэш уже с новым поколением
+void FileIndexer::flushCache(DBManager& db, Touched& touched) {
+    if (const auto cache = db.cache()) {
+        for (const int fileId : touched.files) cache->invalidateFile(fileId); // строки и постинги файла устарели
+        for (const int wordId : touched.words) cache->invalidateWord(wordId); // у слова мог появиться новый файл
+    }
+    touched = Touched();
 }
 
 // обработка одного файла
-void FileIndexer::processFile(const QString& path, const QByteArray& codec) {
+void FileIndexer::processFile(DBManager* db, const QString& path, const QByteArray& codec,
+    const TimestampParser& timeParser, Touched& touched)
+{
+    static const int kCheckpointEvery = 256; // шаг контрольных точек времени, строк
+
     QFile f(path); // открываем файл
-    if (!f.open(QIODevice::ReadOnly | QIODevice::Text)) return; // если не открылся — пропускаем
+    if (!f.open(QIODevice::ReadOnly)) return; // если не открылся — пропускаем
 
-    QTextStream in(&f); // готовим поток чтения
-    in.setCodec(codec.constData()); // ставим кодировку
+    const QByteArray fileCodec = codec.isEmpty() // кодировку смотрим по началу файла
+        ? detectCodec(f.peek(kCodecDetectChunk))
+        : codec;
+    LineReader in(&f, fileCodec); // готовим поток чтения
 
     QHash<QString, QVector<int>> word2lines; // слово - номера строк
     int lineNo = 0; // счётчик строк
 
+    const QDate reference = QFileInfo(f).lastModified().date(); // год для syslog-времени
+    QDateTime minTime, maxTime;
+    QVector<TimeCheckpoint> checkpoints;
+    int timeHint = -1; // последний сработавший шаблон времени
+
     while (!in.atEnd()) { // Читаем построчно
         const QString line = in.readLine(); ++lineNo; // считываем строку и увеличиваем номер
+
+        const QDateTime ts = timeParser.parse(line, timeHint, reference);
+        if (ts.isValid()) { // строка начинается со времени
+            if (!minTime.isValid() || ts < minTime) minTime = ts;
+            if (!maxTime.isValid() || ts > maxTime) maxTime = ts;
+            if (checkpoints.isEmpty() || lineNo - checkpoints.last().first >= kCheckpointEvery)
+                checkpoints.append({ lineNo, ts });
+        }
+
         QString norm = line.toLower();
         norm.replace(QRegularExpression("[^\\p{L}\\d_\\s]"), " "); // убираем пунктуацию и т.п.
 
@@ -67,17 +153,22 @@ void FileIndexer::processFile(const QString& path, const QByteArray& codec) {
     }
 
     QFileInfo fi(f); // собираем данные файла
-    const int fileId = m_db->upsertFile( // вставляем/обновляем запись о файле
-        path, fi.size(), fi.lastModified(), lineNo
+    const int fileId = db->upsertFile( // вставляем/обновляем запись о файле
+        path, fi.size(), fi.lastModified(), lineNo, fileCodec
     );
     if (fileId < 0) return; // если не получилось — выходим
+    db->setTimeIndex(fileId, minTime, maxTime, checkpoints); // время записей для отсечения по интервалу
+
+    db->clearFileIndex(fileId); // слова, пропавшие из файла, не должны находить его по старым строкам
 
+    touched.files.insert(fileId);
     for (auto it = word2lines.cbegin(); it != word2lines.cend(); ++it) { // для каждого слова
         QVector<int> lines = it.value(); // берём список строк
         std::sort(lines.begin(), lines.end()); // сортируем
         lines.erase(std::unique(lines.begin(), lines.end()), lines.end()); // убираем дубли
 
-        const int wordId = m_db->upsertWord(it.key(), lines.size()); // обновляем счётчик слова
-        m_db->upsertWordIndex(wordId, fileId, lines); // cохраняем связь слово—файл со строками
+        const int wordId = db->upsertWord(it.key(), lines.size()); // обновляем счётчик слова
+        db->upsertWordIndex(wordId, fileId, lines); // cохраняем связь слово—файл со строками
+        touched.words.insert(wordId);
     }
 }
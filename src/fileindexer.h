@@ -2,21 +2,42 @@
 #include <QObject>
 #include <QStringList>
 #include <QVector>
+#include <QSet>
+#include <QAtomicInt>
 #include "dbmanager.h"
+#include "shardset.h"
+#include "timeindex.h"
 
 class FileIndexer : public QObject {
     Q_OBJECT
 public:
-    explicit FileIndexer(DBManager* db, QObject* parent = nullptr);
+    explicit FileIndexer(ShardSet* shards, QObject* parent = nullptr);
 
     void scanDirectory(const QString& dirPath,
         const QStringList& masks = { "*.txt","*.log","*.csv" },
-        const QByteArray& codec = "UTF-8");
+        const QByteArray& codec = QByteArray()); //       
+
+    //      (   )
+    void setTimestampParser(const TimestampParser& parser) { m_timeParser = parser; }
 
 private:
-    DBManager* m_db;
+    // id,    
+    struct Touched {
+        QSet<int> files;
+        QSet<int> words;
+    };
+
+    ShardSet* m_shards;
+    TimestampParser m_timeParser;
 
-    void processFile(const QString& path, const QByteArray& codec);
+    //        (   )
+    void indexShard(const Shard& shard, const QString& dirPath,
+        const QSet<QString>& present, const QStringList& files,
+        const QByteArray& codec, QAtomicInt& current, int total);
+    static void processFile(DBManager* db, const QString& path, const QByteArray& codec,
+        const TimestampParser& timeParser, Touched& touched);
+    static void commitBatch(DBManager& db, Touched& touched);
+    static void flushCache(DBManager& db, Touched& touched); //    commit
 
 signals:
     void scanStarted(int totalFiles);           //  
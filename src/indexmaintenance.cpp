@@ -0,0 +1,77 @@
+#include "indexmaintenance.h"
+#include "dbmanager.h"
+#include <QElapsedTimer>
+
+namespace {
+    const int kWordBatch = 20000;  // id слов на одну транзакцию сборки/пересчёта
+    const int kVacuumPages = 2048; // страниц за один срез incremental_vacuum (8 МБ при 4К)
+}
+
+IndexMaintenance::IndexMaintenance(ShardSet* shards, QObject* parent)
+    : QObject(parent), m_shards(shards), m_timer(new QTimer(this))
+{
+    connect(m_timer, &QTimer::timeout, this, &IndexMaintenance::runScheduled);
+}
+
+void IndexMaintenance::setSchedule(int intervalMinutes, int budgetMs) {
+    m_timer->setInterval(intervalMinutes * 60 * 1000);
+    m_budgetMs = budgetMs;
+}
+
+void IndexMaintenance::startSchedule() {
+    if (m_timer->interval() > 0) m_timer->start();
+}
+
+void IndexMaintenance::runScheduled() {
+    run(m_budgetMs, false); // по расписанию файл надолго не блокируем
+}
+
+MaintenanceReport IndexMaintenance::run(int budgetMs, bool convert) {
+    MaintenanceReport report;
+    QElapsedTimer clock;
+    clock.start();
+    const auto over = [&]() { return budgetMs > 0 && clock.elapsed() >= budgetMs; };
+
+    for (const Shard& s : m_shards->shards()) {
+        if (over()) { report.complete = false; break; }
+        DBManager db;
+        if (!db.open(s.dbPath)) continue;
+        const qint64 before = db.sizeBytes();
+
+        // 1. сироты и счётчики — одним проходом по id, с места прошлой остановки
+        int& from = m_wordCursor[s.dbPath];
+        const int last = db.maxWordId();
+        if (from >= last) from = 0;
+        while (from < last && !over()) {
+            const int to = from + kWordBatch;
+            const int removed = db.removeOrphanWords(from, to);
+            const int repaired = db.repairOccurrences(from, to);
+            if (removed < 0 || repaired < 0) break; // ошибка уже в логе
+            report.removedWords += removed;
+            report.repairedWords += repaired;
+            from = to;
+        }
+        if (from < last) report.complete = false;
+
+        // 2. свободные страницы — обратно ОС, срезами между которыми читает поиск
+        if (!db.isIncrementalVacuum() && convert) db.enableIncrementalVacuum();
+        if (db.isIncrementalVacuum()) {
+            while (db.freePages() > 0 && !over())
+                if (!db.vacuumStep(kVacuumPages)) break;
+            if (db.freePages() > 0) report.complete = false;
+        }
+        else {
+            report.needsConversion = true; // по расписанию файл не блокируем — ждём запуска из меню
+        }
+
+        // 3. статистика планировщика и сброс WAL
+        db.optimize();
+        const qint64 after = db.sizeBytes();
+        report.reclaimedBytes += qMax<qint64>(0, before - after);
+        report.sizeBytes += after;
+    }
+
+    emit finished(report.removedWords, report.repairedWords, report.reclaimedBytes, report.complete,
+        report.needsConversion);
+    return report;
+}
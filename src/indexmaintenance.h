@@ -0,0 +1,47 @@
+#pragma once
+#include <QObject>
+#include <QHash>
+#include <QTimer>
+#include "shardset.h"
+
+// итог одного прохода обслуживания по всем шардам
+struct MaintenanceReport {
+    int    removedWords = 0;   // слова без единого постинга
+    int    repairedWords = 0;  // исправленные счётчики occurrences
+    qint64 reclaimedBytes = 0; // на сколько уменьшились файлы БД
+    qint64 sizeBytes = 0;      // суммарный размер после прохода
+    bool   complete = true;    // false — упёрлись в бюджет, остаток в следующий раз
+    bool   needsConversion = false; // есть шарды без auto_vacuum: место вернёт только запуск по запросу
+};
+
+// фоновое обслуживание индекса: сборка осиротевших слов, пересчёт счётчиков,
+// инкрементальный VACUUM и PRAGMA optimize. Живёт в потоке записи рядом с
+// FileIndexer, поэтому не пересекается со сканом; работает пачками в коротких
+// транзакциях, а WAL позволяет поиску читать всё это время
+class IndexMaintenance : public QObject {
+    Q_OBJECT
+public:
+    explicit IndexMaintenance(ShardSet* shards, QObject* parent = nullptr);
+
+    // вызывать до moveToThread; 0 — только по запросу
+    void setSchedule(int intervalMinutes, int budgetMs = 2000);
+
+    // budgetMs = 0 — без ограничения по времени;
+    // convert — разрешить полный VACUUM старых БД без auto_vacuum (блокирует файл)
+    MaintenanceReport run(int budgetMs = 0, bool convert = true);
+
+public slots:
+    void startSchedule(); // запуск таймера уже в рабочем потоке (QThread::started)
+
+signals:
+    void finished(int removedWords, int repairedWords, qint64 reclaimedBytes, bool complete,
+        bool needsConversion);
+
+private:
+    ShardSet* m_shards;
+    QTimer* m_timer;
+    int m_budgetMs = 2000;
+    QHash<QString, int> m_wordCursor; // шард -> id слова, с которого продолжить проход
+
+    void runScheduled();
+};
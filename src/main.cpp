@@ -1,10 +1,45 @@
 #include "mainwindow.h"
+#include "searchserver.h"
 #include <QtWidgets/QApplication>
+#include <QCommandLineParser>
+
+namespace {
+    // общие ключи для GUI и фонового сервера
+    void parseArgs(QCommandLineParser& parser, const QCoreApplication& app) {
+        parser.addHelpOption();
+        parser.addOption({ "daemon", "Run headless search server." });
+        parser.addOption({ "server", "Local server name (GUI: connect as a thin client).", "name" });
+        parser.addOption({ "index", "Shard directory.", "dir", "index" });
+        parser.addOption({ "threads", "Concurrent queries (daemon).", "n" });
+        parser.addOption({ "compact-every", "Index maintenance interval, 0 = on demand only (daemon default: 360).", "minutes" });
+        parser.process(app);
+    }
+}
 
 int main(int argc, char *argv[])
 {
+    // --daemon: без окон, поэтому QCoreApplication
+    for (int i = 1; i < argc; ++i) {
+        if (qstrcmp(argv[i], "--daemon") != 0) continue;
+
+        QCoreApplication app(argc, argv);
+        QCommandLineParser parser;
+        parseArgs(parser, app);
+
+        SearchServer server;
+        const QString name = parser.isSet("server") ? parser.value("server") : SearchServer::defaultName();
+        const int threads = parser.isSet("threads") ? parser.value("threads").toInt() : QThread::idealThreadCount();
+        const int compact = parser.isSet("compact-every") ? parser.value("compact-every").toInt() : 360; // раз в 6 часов
+        if (!server.start(name, parser.value("index"), threads, compact)) return 1;
+        return app.exec();
+    }
+
     QApplication app(argc, argv);
-    MainWindow window;
+    QCommandLineParser parser;
+    parseArgs(parser, app);
+
+    MainWindow window(nullptr, parser.value("server"), parser.value("index"),
+        parser.value("compact-every").toInt()); // без ключа — только из меню
     window.show();
     return app.exec();
 }
@@ -17,38 +17,106 @@
 #include <QTextDocument>
 #include <QThread>
 #include <QShortcut>
-
-MainWindow::MainWindow(QWidget* parent)
-    : QMainWindow(parent), m_db(this)
+#include <QInputDialog>
+#include <QMessageBox>
+#include <QSettings>
+#include <QCoreApplication>
+
+MainWindow::MainWindow(QWidget* parent, const QString& serverName, const QString& indexDir,
+    int compactMinutes)
+    : QMainWindow(parent)
 {
     ui.setupUi(this);
     setupResultsTable();
     setupShortcuts();
 
-    m_db.open("index.db");
-
     ui.tableWidgetResults->setContextMenuPolicy(Qt::CustomContextMenu); //меню ПКМ
+
+    // интервал времени записей по умолчанию — последний час (без этого в полях 01.01.2000)
+    const QDateTime now = QDateTime::currentDateTime();
+    ui.dateTimeEditFrom->setDateTime(now.addSecs(-3600));
+    ui.dateTimeEditTo->setDateTime(now);
     statusBar()->showMessage(QString::fromUtf8("Готово"));
 
+    // общий тёплый индекс на сервере поиска
+    if (!serverName.isEmpty()) {
+        m_client = new SearchClient;
+        if (m_client->connectTo(serverName)) {
+            ui.actionAttachShard->setEnabled(false); // шардами управляет сервер
+            ui.actionDetachShard->setEnabled(false);
+            if (!m_client->isTrusted()) { // сервер чужого пользователя: только поиск
+                ui.pushButtonScan->setEnabled(false);
+                ui.actionClearIndex->setEnabled(false);
+                ui.actionCompactIndex->setEnabled(false);
+            }
+            statusBar()->showMessage(QString::fromUtf8("Подключено к серверу %1").arg(serverName));
+        }
+        else {
+            delete m_client; m_client = nullptr;
+            statusBar()->showMessage(QString::fromUtf8("Сервер %1 недоступен, работаем локально").arg(serverName));
+        }
+    }
+
+    if (m_client) { // тонкому клиенту свой индекс не нужен; о конце сканирования сообщит сервер
+        connect(m_client, &SearchClient::scanFinished, this, [this](bool ok, const QString& error) {
+            statusBar()->showMessage(ok
+                ? QString::fromUtf8("Индексирование на сервере завершено")
+                : QString::fromUtf8("Сервер не выполнил сканирование: %1").arg(error));
+            });
+    }
+    else {
+        setupLocalIndex(indexDir, compactMinutes);
+    }
+}
+
+MainWindow::~MainWindow() {
+    if (m_thread) {
+        m_thread->quit();
+        m_thread->wait();
+    }
+    delete m_client;
+}
+
+// сервер чужого пользователя принимает только поиск
+bool MainWindow::canModifyIndex() {
+    if (!m_client || m_client->isTrusted()) return true;
+    statusBar()->showMessage(QString::fromUtf8("Сервер разрешает только поиск"));
+    return false;
+}
+
+// локальный индекс: шарды, поток записи с индексатором и обслуживанием
+void MainWindow::setupLocalIndex(const QString& indexDir, int compactMinutes) {
+    m_shards.open(indexDir); // каталог с шардами рядом с исполняемым
+
     // создаём поток
     m_thread = new QThread(this);
-    m_dbWorker = new DBManager();
-    m_dbWorker->moveToThread(m_thread);
-    connect(m_thread, &QThread::started, m_dbWorker, [this]() {
-        m_dbWorker->open("index.db"); // открываем БД именно в потоке
-        });
 
-    // индексатор
-    m_indexer = new FileIndexer(m_dbWorker);
+    // индексатор (шарды он открывает сам, в потоках пула)
+    m_indexer = new FileIndexer(&m_shards);
+
+    // свои форматы времени в логах можно добавить в timestamps.ini рядом с исполняемым
+    TimestampParser timeParser;
+    QSettings timeIni(QDir(QCoreApplication::applicationDirPath()).filePath("timestamps.ini"),
+        QSettings::IniFormat);
+    timeParser.loadPatterns(timeIni);
+    m_indexer->setTimestampParser(timeParser);
     m_indexer->moveToThread(m_thread);
 
     connect(m_thread, &QThread::finished, m_indexer, &QObject::deleteLater);
-    connect(m_thread, &QThread::finished, m_dbWorker, &QObject::deleteLater);
+
+    // обслуживание индекса — в том же потоке, чтобы не пересекаться со сканом
+    m_maintenance = new IndexMaintenance(&m_shards);
+    m_maintenance->setSchedule(compactMinutes);
+    m_maintenance->moveToThread(m_thread);
+    connect(m_thread, &QThread::started, m_maintenance, &IndexMaintenance::startSchedule);
+    connect(m_thread, &QThread::finished, m_maintenance, &QObject::deleteLater);
+    connect(m_maintenance, &IndexMaintenance::finished, this, &MainWindow::showMaintenanceReport,
+        Qt::QueuedConnection);
 
     // сигнал запуска сканирования
     connect(this, &MainWindow::startScan, m_indexer,
         [this](const QString& dir) {
-            m_indexer->scanDirectory(dir, { "*.txt","*.log","*.csv" }, "UTF-8");
+            m_indexer->scanDirectory(dir, { "*.txt","*.log","*.csv" }); // кодировка — своя у каждого файла
         });
 
     // прогресс — обратно в GUI
@@ -72,13 +140,6 @@ MainWindow::MainWindow(QWidget* parent)
     m_thread->start();
 }
 
-MainWindow::~MainWindow() {
-    if (m_thread) {
-        m_thread->quit();
-        m_thread->wait();
-    }
-}
-
 //настройка таблицы результата
 void MainWindow::setupResultsTable() {
     auto* t = ui.tableWidgetResults;
@@ -135,11 +196,17 @@ void MainWindow::on_pushButtonBrowse_clicked() {
 
 //запуск индексации
 void MainWindow::on_pushButtonScan_clicked() {
+    if (!canModifyIndex()) return; // F5 работает и при выключенной кнопке
     const QString dir = ui.lineEditDirectory->text();
     if (dir.isEmpty()) {
         statusBar()->showMessage(QString::fromUtf8("Укажите директорию для сканирования"));
         return;
     }
+    if (m_client) { // индексирует сервер, прогресс остаётся у него
+        m_client->scanAsync(dir);
+        statusBar()->showMessage(QString::fromUtf8("Сканирование запущено на сервере"));
+        return;
+    }
     emit startScan(dir); // ← правильно: запускаем асинхронно в воркере
 }
 
@@ -161,59 +228,111 @@ void MainWindow::on_pushButtonSearch_clicked() {
         return {};
         }();
 
-    const QDate from = ui.dateEditFrom->date(); //фильтр "с даты"
-    const QDate to = ui.dateEditTo->date(); //фильтр "по дату"
-
-    QVector<SearchResult> rows = regex //выбор регулярное выражение или точное слово
-        ? SearchEngine::searchRegex(&m_db, q, caseSens, mask, from, to)
-        : SearchEngine::searchWord(&m_db, q, caseSens, mask, from, to);
+    SearchRequest req; //параметры поиска
+    req.query = q;
+    req.regex = regex;
+    req.caseSensitive = caseSens;
+    req.fileMask = mask;
+    req.from = ui.dateEditFrom->date(); //фильтр "с даты"
+    req.to = ui.dateEditTo->date(); //фильтр "по дату"
+    if (ui.checkBoxTime->isChecked()) { //фильтр по времени записей в строках
+        if (ui.dateTimeEditFrom->dateTime() > ui.dateTimeEditTo->dateTime()) { // перепутанные границы меняем местами
+            const QDateTime t = ui.dateTimeEditFrom->dateTime();
+            ui.dateTimeEditFrom->setDateTime(ui.dateTimeEditTo->dateTime());
+            ui.dateTimeEditTo->setDateTime(t);
+        }
+        req.time = { ui.dateTimeEditFrom->dateTime(), ui.dateTimeEditTo->dateTime() };
+    }
+    req.context = ui.spinBoxContext->value(); //строк контекста до/после
+
+    int found = 0;
+    QVector<SearchResult> rows;
+    QVector<SnippetWindow> windows;
+    CacheStats cs;
+    if (m_client) { //поиск на сервере
+        if (!m_client->search(req, found, rows, windows) || !m_client->stats(cs)) {
+            statusBar()->showMessage(QString::fromUtf8("Сервер поиска не отвечает"));
+            return;
+        }
+    }
+    else {
+        rows = regex //выбор регулярное выражение или точное слово
+            ? SearchEngine::searchRegex(&m_shards, q, caseSens, mask, req.from, req.to, req.time)
+            : SearchEngine::searchWord(&m_shards, q, caseSens, mask, req.from, req.to, req.time);
+        found = rows.size();
+        if (req.context > 0)
+            windows = SearchEngine::buildSnippets(&m_shards, rows, req.context);
+        cs = m_shards.cacheStats(); // доля попаданий в кэш
+    }
 
-    fillResults(rows, q, caseSens); //заполнение таблицы + подсветка
-    statusBar()->showMessage(QString::fromUtf8("Найдено: %1").arg(rows.size()));
+    if (req.context > 0)
+        fillSnippets(windows, q, caseSens); //окна контекста
+    else
+        fillResults(rows, q, caseSens); //заполнение таблицы + подсветка
+    statusBar()->showMessage(QString::fromUtf8("Найдено: %1 | кэш: постинги %2%, строки %3%")
+        .arg(found)
+        .arg(qRound(cs.postingHitRate() * 100))
+        .arg(qRound(cs.fragmentHitRate() * 100)));
 }
 
-//заполнение таблицы результатов
-void MainWindow::fillResults(const QVector<SearchResult>& rows,
-    const QString& query, bool caseSensitive)
-{
-    auto* t = ui.tableWidgetResults;
-    t->setRowCount(rows.size()); 
-
+//регулярка для подсветки совпадений
+QRegularExpression MainWindow::highlightRegex(const QString& query, bool caseSensitive) const {
     const bool isRegex = ui.checkBoxRegex->isChecked();
     QRegularExpression::PatternOptions opts = QRegularExpression::UseUnicodePropertiesOption;
     if (!caseSensitive) opts |= QRegularExpression::CaseInsensitiveOption;
 
-    const QRegularExpression re(
+    return QRegularExpression(
         isRegex ? query : QRegularExpression::escape(query),
         opts
     );
-    auto makeHtml = [&re](const QString& text) -> QString {
-        if (text.isEmpty() || !re.isValid())
-            return text.toHtmlEscaped();
-
-        QString html; html.reserve(text.size() + 64);
-        int pos = 0;
-        auto it = re.globalMatch(text);
-
-        while (it.hasNext()) {
-            const QRegularExpressionMatch m = it.next();
-            const int start = m.capturedStart();
-            const int len = m.capturedLength();
-            if (start < 0 || len <= 0) continue; // защита от нулевой длины
-
-            // обычный фрагмент
-            html += text.mid(pos, start - pos).toHtmlEscaped();
-            // совпадение
-            html += "<span style='background-color: yellow; color: black;'><b>";
-            html += text.mid(start, len).toHtmlEscaped();
-            html += "</b></span>";
-
-            pos = start + len;
-        }
-        // хвост
-        html += text.mid(pos).toHtmlEscaped();
-        return html;
-        };
+}
+
+//HTML строки с подсвеченными совпадениями
+QString MainWindow::highlightHtml(const QString& text, const QRegularExpression& re) {
+    if (text.isEmpty() || !re.isValid())
+        return text.toHtmlEscaped();
+
+    QString html; html.reserve(text.size() + 64);
+    int pos = 0;
+    auto it = re.globalMatch(text);
+
+    while (it.hasNext()) {
+        const QRegularExpressionMatch m = it.next();
+        const int start = m.capturedStart();
+        const int len = m.capturedLength();
+        if (start < 0 || len <= 0) continue; // защита от нулевой длины
+
+        // обычный фрагмент
+        html += text.mid(pos, start - pos).toHtmlEscaped();
+        // совпадение
+        html += "<span style='background-color: yellow; color: black;'><b>";
+        html += text.mid(start, len).toHtmlEscaped();
+        html += "</b></span>";
+
+        pos = start + len;
+    }
+    // хвост
+    html += text.mid(pos).toHtmlEscaped();
+    return html;
+}
+
+//QLabel для ячейки с фрагментом
+QLabel* MainWindow::makeFragmentLabel(const QString& html) {
+    auto* lbl = new QLabel;
+    lbl->setTextFormat(Qt::RichText);
+    lbl->setTextInteractionFlags(Qt::TextSelectableByMouse);
+    lbl->setWordWrap(true);
+    lbl->setText(html);
+    return lbl;
+}
+
+//заполнение таблицы результатов
+void MainWindow::fillResults(const QVector<SearchResult>& rows,
+    const QString& query, bool caseSensitive)
+{
+    auto* t = ui.tableWidgetResults;
+    t->setRowCount(rows.size()); 
+    const QRegularExpression re = highlightRegex(query, caseSensitive);
 
     for (int i = 0; i < rows.size(); ++i) {
         const auto& r = rows[i];
@@ -224,13 +343,41 @@ void MainWindow::fillResults(const QVector<SearchResult>& rows,
         t->setItem(i, 3, new QTableWidgetItem(r.modified));
         t->setItem(i, 4, new QTableWidgetItem(QLocale::system().formattedDataSize(r.size)));
 
-        // фрагмент с подсветкой
-        auto* lbl = new QLabel;
-        lbl->setTextFormat(Qt::RichText);
-        lbl->setTextInteractionFlags(Qt::TextSelectableByMouse);
-        lbl->setWordWrap(true);
-        lbl->setText(makeHtml(r.fragment));
-        t->setCellWidget(i, 2, lbl);
+        // фрагмент с подсветкой (SearchEngine уже оставил только окрестность совпадения)
+        t->setCellWidget(i, 2, makeFragmentLabel(highlightHtml(r.fragment, re)));
+    }
+
+    t->resizeColumnsToContents();
+}
+
+//заполнение таблицы окнами контекста
+void MainWindow::fillSnippets(const QVector<SnippetWindow>& windows,
+    const QString& query, bool caseSensitive)
+{
+    auto* t = ui.tableWidgetResults;
+    t->setRowCount(windows.size());
+    const QRegularExpression re = highlightRegex(query, caseSensitive);
+
+    for (int i = 0; i < windows.size(); ++i) {
+        const auto& w = windows[i];
+
+        t->setItem(i, 0, new QTableWidgetItem(w.file));
+        t->setItem(i, 1, new QTableWidgetItem(w.firstLine == w.lastLine
+            ? QString::number(w.firstLine)
+            : QString("%1-%2").arg(w.firstLine).arg(w.lastLine)));
+        t->setItem(i, 3, new QTableWidgetItem(w.modified));
+        t->setItem(i, 4, new QTableWidgetItem(QLocale::system().formattedDataSize(w.size)));
+
+        // строки окна: совпадения подсвечены, контекст серым
+        QStringList html;
+        for (int k = 0; k < w.lines.size(); ++k) {
+            const int lineNo = w.firstLine + k;
+            const QString prefix = QString("%1: ").arg(lineNo);
+            html << (w.hitLines.contains(lineNo)
+                ? prefix.toHtmlEscaped() + highlightHtml(w.lines[k], re)
+                : "<span style='color: gray;'>" + (prefix + w.lines[k]).toHtmlEscaped() + "</span>");
+        }
+        t->setCellWidget(i, 2, makeFragmentLabel(html.join("<br>")));
     }
 
     t->resizeColumnsToContents();
@@ -276,10 +423,75 @@ void MainWindow::on_tableWidgetResults_customContextMenuRequested(const QPoint&
 }
 
 void MainWindow::on_actionClearIndex_triggered() { // очитска
-    if (m_db.clearAll())
+    if (!canModifyIndex()) return; // Ctrl+Shift+Delete работает и при выключенном пункте меню
+    if (m_client ? m_client->clearAll() : m_shards.clearAll())
         statusBar()->showMessage(QString::fromUtf8("Индекс очищен"));
 }
 
+void MainWindow::on_actionCompactIndex_triggered() { // обслуживание по запросу
+    if (!canModifyIndex()) return;
+    statusBar()->showMessage(QString::fromUtf8("Обслуживание индекса..."));
+    if (m_client) { // сервер отвечает по окончании прохода
+        QApplication::setOverrideCursor(Qt::WaitCursor);
+        MaintenanceReport r;
+        const bool ok = m_client->compact(r);
+        QApplication::restoreOverrideCursor();
+        if (ok) showMaintenanceReport(r.removedWords, r.repairedWords, r.reclaimedBytes, r.complete,
+            r.needsConversion);
+        else statusBar()->showMessage(QString::fromUtf8("Сервер не выполнил обслуживание"));
+        return;
+    }
+    QMetaObject::invokeMethod(m_maintenance, [this]() { m_maintenance->run(); },
+        Qt::QueuedConnection); // итог придёт сигналом finished
+}
+
+void MainWindow::showMaintenanceReport(int removedWords, int repairedWords,
+    qint64 reclaimedBytes, bool complete, bool needsConversion)
+{
+    statusBar()->showMessage(QString::fromUtf8("Обслуживание%1: удалено слов %2, исправлено счётчиков %3, освобождено %4%5")
+        .arg(complete ? QString() : QString::fromUtf8(" (частично)"))
+        .arg(removedWords).arg(repairedWords)
+        .arg(locale().formattedDataSize(reclaimedBytes))
+        .arg(needsConversion // старые БД сжимает только запуск из меню (полный VACUUM)
+            ? QString::fromUtf8("; для возврата места запустите обслуживание из меню")
+            : QString()));
+}
+
+void MainWindow::on_actionAttachShard_triggered() { // подключить БД архива
+    const QString dbPath = QFileDialog::getSaveFileName(this, // существующий архив или новый файл
+        QString::fromUtf8("Файл индекса"), m_shards.dirPath(), "SQLite (*.db)",
+        nullptr, QFileDialog::DontConfirmOverwrite);
+    if (dbPath.isEmpty()) return;
+    const QString root = QFileDialog::getExistingDirectory(this,
+        QString::fromUtf8("Корневая папка файлов этого индекса"));
+    if (root.isEmpty()) return;
+
+    statusBar()->showMessage(m_shards.attach(dbPath, root)
+        ? QString::fromUtf8("Шард подключён")
+        : QString::fromUtf8("Не удалось подключить шард"));
+}
+
+void MainWindow::on_actionDetachShard_triggered() { // отключить шард с корнем
+    QStringList names;
+    for (const Shard& s : m_shards.shards())
+        if (!s.isHashShard()) names << s.name;
+    if (names.isEmpty()) {
+        statusBar()->showMessage(QString::fromUtf8("Нет подключённых шардов"));
+        return;
+    }
+
+    bool ok = false;
+    const QString name = QInputDialog::getItem(this, QString::fromUtf8("Отключить шард"),
+        QString::fromUtf8("Шард:"), names, 0, false, &ok);
+    if (!ok) return;
+    const bool removeFile = QMessageBox::question(this, QString::fromUtf8("Отключить шард"),
+        QString::fromUtf8("Удалить файл индекса с диска?")) == QMessageBox::Yes;
+
+    statusBar()->showMessage(m_shards.detach(name, removeFile)
+        ? QString::fromUtf8("Шард отключён")
+        : QString::fromUtf8("Не удалось отключить шард или удалить его файлы"));
+}
+
 void MainWindow::on_actionExit_triggered() { close(); } // выход
 
 void MainWindow::setupShortcuts() {
@@ -4,13 +4,19 @@
 #include <QThread>  
 #include "ui_mainwindow.h"
 #include "dbmanager.h"
+#include "shardset.h"
 #include "fileindexer.h"
+#include "indexmaintenance.h"
 #include "searchengine.h"
+#include "searchclient.h"
 
 class MainWindow : public QMainWindow {
     Q_OBJECT
 public:
-    MainWindow(QWidget* parent = nullptr);
+    // serverName — имя сервера поиска: если он доступен, окно работает тонким клиентом;
+    // compactMinutes — период фонового обслуживания локального индекса (0 — только из меню)
+    MainWindow(QWidget* parent = nullptr, const QString& serverName = QString(),
+        const QString& indexDir = "index", int compactMinutes = 0);
     ~MainWindow();
 
 private slots:
@@ -19,6 +25,9 @@ private slots:
     void on_pushButtonSearch_clicked();
     void on_tableWidgetResults_customContextMenuRequested(const QPoint& pos);
     void on_actionClearIndex_triggered();
+    void on_actionAttachShard_triggered();
+    void on_actionDetachShard_triggered();
+    void on_actionCompactIndex_triggered();
     void on_actionExit_triggered();
 
 signals:
@@ -26,15 +35,26 @@ signals:
 
 private:
     Ui::MainWindowClass ui;
-    DBManager m_db;             // GUI‑подключение (поиск)
-    DBManager* m_dbWorker = nullptr; // добавили DB в потоке индексации
+    ShardSet m_shards;          // шарды индекса (подключения открываются в потоках)
     FileIndexer* m_indexer = nullptr;
+    IndexMaintenance* m_maintenance = nullptr; // живёт в потоке индексатора
+    SearchClient* m_client = nullptr; // подключение к серверу поиска (если есть)
     QThread* m_thread = nullptr;
 
     void setupShortcuts();
     void setupResultsTable();
+    void setupLocalIndex(const QString& indexDir, int compactMinutes);
+    bool canModifyIndex(); // false (с сообщением) — клиент только для поиска
+    void showMaintenanceReport(int removedWords, int repairedWords, qint64 reclaimedBytes, bool complete,
+        bool needsConversion);
     void fillResults(const QVector<SearchResult>& rows,
         const QString& query, bool caseSensitive);
+    void fillSnippets(const QVector<SnippetWindow>& windows,
+        const QString& query, bool caseSensitive);
+
+    QRegularExpression highlightRegex(const QString& query, bool caseSensitive) const;
+    static QString highlightHtml(const QString& text, const QRegularExpression& re);
+    static QLabel* makeFragmentLabel(const QString& html);
 
     static void setHighlightedText(QTableWidget* table, int row, int col,
         const QString& text,
@@ -0,0 +1,113 @@
+#include "searchcache.h"
+#include <QFileInfo>
+#include <QHash>
+#include <QMutexLocker>
+
+namespace {
+    double hitRate(qint64 hits, qint64 misses) {
+        const qint64 total = hits + misses;
+        return total > 0 ? double(hits) / double(total) : 0.0;
+    }
+}
+
+double CacheStats::postingHitRate() const { return hitRate(postingHits, postingMisses); }
+double CacheStats::fragmentHitRate() const { return hitRate(fragmentHits, fragmentMisses); }
+
+SearchCache::SearchCache(int maxPostingLists, int maxFragmentChars)
+    : m_postings(maxPostingLists), m_fragments(maxFragmentChars) {
+}
+
+QSharedPointer<SearchCache> SearchCache::forDatabase(const QString& dbPath) {
+    static QMutex registryMutex;
+    static QHash<QString, QSharedPointer<SearchCache>> registry;
+
+    const QString key = QFileInfo(dbPath).absoluteFilePath(); // один ключ для разных записей пути
+    QMutexLocker lock(&registryMutex);
+    auto& cache = registry[key];
+    if (!cache) cache = QSharedPointer<SearchCache>::create();
+    return cache;
+}
+
+quint64 SearchCache::generation() const {
+    QMutexLocker lock(&m_mutex);
+    return m_generation;
+}
+
+bool SearchCache::postings(int wordId, PostingList& out) {
+    QMutexLocker lock(&m_mutex);
+    if (const auto* entry = m_postings.object(wordId)) { // object() поднимает запись в LRU
+        out = entry->value;
+        ++m_stats.postingHits;
+        return true;
+    }
+    ++m_stats.postingMisses;
+    return false;
+}
+
+void SearchCache::putPostings(int wordId, const PostingList& list, quint64 generation) {
+    QMutexLocker lock(&m_mutex);
+    if (generation != m_generation) return; // пока читали из БД, индекс успел поменяться
+    m_postings.remove(wordId); // старая запись чистит обратный индекс до того, как заполним его заново
+
+    auto* entry = new Entry<int, PostingList>{ list, wordId, {}, &m_postingsByFile };
+    entry->files.reserve(list.size());
+    for (const Posting& p : list) {
+        entry->files.append(p.fileId);
+        m_postingsByFile[p.fileId].insert(wordId);
+    }
+    m_postings.insert(wordId, entry);
+}
+
+bool SearchCache::fragment(int fileId, int lineNo, QString& out) {
+    QMutexLocker lock(&m_mutex);
+    if (const auto* entry = m_fragments.object(fragmentKey(fileId, lineNo))) {
+        out = entry->value;
+        ++m_stats.fragmentHits;
+        return true;
+    }
+    ++m_stats.fragmentMisses;
+    return false;
+}
+
+void SearchCache::putFragment(int fileId, int lineNo, const QString& text, quint64 generation) {
+    QMutexLocker lock(&m_mutex);
+    if (generation != m_generation) return;
+    if (text.size() > m_fragments.maxCost() / 256) return; // одна гигантская строка вытеснила бы весь кэш
+    const quint64 key = fragmentKey(fileId, lineNo);
+    m_fragments.remove(key);
+    m_fragmentsByFile[fileId].insert(key);
+    m_fragments.insert(key, new Entry<quint64, QString>{ text, key, { fileId }, &m_fragmentsByFile },
+        qMax(1, text.size()));
+}
+
+void SearchCache::invalidateFile(int fileId) {
+    QMutexLocker lock(&m_mutex);
+    ++m_generation;
+
+    // по обратному индексу: порядок LRU остальных записей не трогаем;
+    // копии множеств — remove() правит их через деструктор записи
+    for (const int wordId : m_postingsByFile.value(fileId)) m_postings.remove(wordId);
+    for (const quint64 key : m_fragmentsByFile.value(fileId)) m_fragments.remove(key);
+}
+
+void SearchCache::invalidateWord(int wordId) {
+    QMutexLocker lock(&m_mutex);
+    ++m_generation;
+    m_postings.remove(wordId);
+}
+
+void SearchCache::clear() {
+    QMutexLocker lock(&m_mutex);
+    ++m_generation;
+    m_postings.clear();
+    m_fragments.clear();
+}
+
+CacheStats SearchCache::stats() const {
+    QMutexLocker lock(&m_mutex);
+    return m_stats;
+}
+
+quint64 SearchCache::fragmentKey(int fileId, int lineNo) {
+    return (quint64(quint32(fileId)) << 32) | quint32(lineNo);
+}
@@ -0,0 +1,88 @@
+#pragma once
+#include <QByteArray>
+#include <QCache>
+#include <QHash>
+#include <QMutex>
+#include <QSet>
+#include <QSharedPointer>
+#include <QString>
+#include <QVector>
+
+// одна запись постинга: файл и строки, где встречается слово
+struct Posting {
+    int     fileId = -1;
+    QString path;
+    QString modified;
+    qint64  size = 0;
+    QString minTime; // границы времени записей (пусто — в файле нет времени)
+    QString maxTime;
+    QByteArray codec; // кодировка файла (пусто — UTF-8)
+    QVector<int> lines;
+};
+using PostingList = QVector<Posting>;
+
+// счётчики попаданий в кэш
+struct CacheStats {
+    qint64 postingHits = 0;
+    qint64 postingMisses = 0;
+    qint64 fragmentHits = 0;
+    qint64 fragmentMisses = 0;
+
+    double postingHitRate() const;
+    double fragmentHitRate() const;
+};
+
+// кэш декодированных постингов (LRU по word id) и прочитанных строк (по file id + строке)
+class SearchCache {
+public:
+    explicit SearchCache(int maxPostingLists = 1024, int maxFragmentChars = 16 * 1024 * 1024);
+
+    // один общий кэш на файл БД (GUI и поток индексации видят одно и то же)
+    static QSharedPointer<SearchCache> forDatabase(const QString& dbPath);
+
+    // поколение растёт при каждой инвалидации: put* с устаревшим поколением игнорируется
+    quint64 generation() const;
+
+    bool postings(int wordId, PostingList& out);
+    void putPostings(int wordId, const PostingList& list, quint64 generation);
+
+    bool fragment(int fileId, int lineNo, QString& out);
+    void putFragment(int fileId, int lineNo, const QString& text, quint64 generation);
+
+    void invalidateFile(int fileId);
+    void invalidateWord(int wordId);
+    void clear();
+
+    CacheStats stats() const;
+
+private:
+    // запись кэша, которая при вытеснении или удалении сама убирает себя
+    // из обратного индекса file id -> ключи (QCache удаляет объекты под нашим мьютексом)
+    template <typename Key, typename T>
+    struct Entry {
+        T value;
+        Key key;
+        QVector<int> files;
+        QHash<int, QSet<Key>>* byFile;
+
+        ~Entry() {
+            for (const int fileId : files) {
+                auto it = byFile->find(fileId);
+                if (it == byFile->end()) continue;
+                it->remove(key);
+                if (it->isEmpty()) byFile->erase(it);
+            }
+        }
+    };
+
+    static quint64 fragmentKey(int fileId, int lineNo);
+
+    mutable QMutex m_mutex;
+    // обратные индексы объявлены раньше кэшей: разрушаются после них
+    QHash<int, QSet<int>> m_postingsByFile;      // file id -> word id
+    QHash<int, QSet<quint64>> m_fragmentsByFile; // file id -> ключи строк
+    QCache<int, Entry<int, PostingList>> m_postings;  // стоимость записи = 1, лимит = число списков
+    QCache<quint64, Entry<quint64, QString>> m_fragments; // стоимость записи = длина строки
+    CacheStats m_stats;
+    quint64 m_generation = 0;
+};
@@ -0,0 +1,103 @@
+#include "searchclient.h"
+#include <QJsonArray>
+#include <QDebug>
+
+SearchClient::SearchClient(QObject* parent) : QObject(parent) {
+    connect(&m_socket, &QLocalSocket::readyRead, this, &SearchClient::onReadyRead);
+}
+
+bool SearchClient::connectTo(const QString& name, int timeoutMs) {
+    m_socket.connectToServer(SearchProtocol::adminName(name)); // чужому пользователю ОС не даст подключиться
+    m_trusted = m_socket.waitForConnected(timeoutMs);
+    if (m_trusted) return true;
+    m_socket.abort();
+    m_socket.connectToServer(name);
+    return m_socket.waitForConnected(timeoutMs);
+}
+
+int SearchClient::post(QJsonObject msg) {
+    const int id = m_nextId++;
+    msg["id"] = id;
+    SearchProtocol::writeFrame(&m_socket, msg);
+    m_socket.flush();
+    return id;
+}
+
+bool SearchClient::request(QJsonObject msg, QJsonObject& reply, int timeoutMs) {
+    if (!isConnected()) return false;
+    const int id = post(msg);
+    m_inRequest = true; // waitForReadyRead тоже шлёт readyRead — сокет читаем только здесь
+    const bool ok = waitReply(id, reply, timeoutMs);
+    m_inRequest = false;
+    return ok;
+}
+
+bool SearchClient::waitReply(int id, QJsonObject& reply, int timeoutMs) {
+    for (;;) {
+        bool ok = true;
+        while (SearchProtocol::takeFrame(m_buffer, reply, ok)) {
+            if (reply["id"].toInt() == id) return reply["ok"].toBool();
+            dispatch(reply); // ответ на более ранний асинхронный запрос
+        }
+        if (!ok) { m_socket.disconnectFromServer(); return false; }
+        if (!m_socket.waitForReadyRead(timeoutMs)) { // сервер молчит или отключился
+            qWarning() << "Search server:" << m_socket.errorString();
+            return false;
+        }
+        m_buffer += m_socket.readAll();
+    }
+}
+
+bool SearchClient::search(const SearchRequest& r, int& count,
+    QVector<SearchResult>& rows, QVector<SnippetWindow>& windows)
+{
+    QJsonObject msg = SearchProtocol::toJson(r);
+    msg["cmd"] = "search";
+    QJsonObject reply;
+    if (!request(msg, reply)) return false;
+
+    count = reply["count"].toInt();
+    rows.clear();
+    windows.clear();
+    for (const QJsonValue& v : reply["results"].toArray()) rows << SearchProtocol::resultFromJson(v.toObject());
+    for (const QJsonValue& v : reply["windows"].toArray()) windows << SearchProtocol::windowFromJson(v.toObject());
+    return true;
+}
+
+bool SearchClient::stats(CacheStats& out) {
+    QJsonObject reply;
+    if (!request({ { "cmd", "stats" } }, reply)) return false;
+    out = SearchProtocol::statsFromJson(reply["cache"].toObject());
+    return true;
+}
+
+bool SearchClient::clearAll() {
+    QJsonObject reply;
+    return request({ { "cmd", "clear" } }, reply);
+}
+
+bool SearchClient::compact(MaintenanceReport& out) {
+    QJsonObject reply;
+    if (!request({ { "cmd", "compact" } }, reply, 30 * 60000)) return false;
+    out = SearchProtocol::reportFromJson(reply["report"].toObject());
+    return true;
+}
+
+void SearchClient::scanAsync(const QString& dir) {
+    if (isConnected()) m_pendingScans.insert(post({ { "cmd", "scan" }, { "dir", dir } }));
+}
+
+void SearchClient::onReadyRead() {
+    if (m_inRequest) return;
+    m_buffer += m_socket.readAll();
+    QJsonObject reply;
+    bool ok = true;
+    while (SearchProtocol::takeFrame(m_buffer, reply, ok)) dispatch(reply);
+    if (!ok) m_socket.disconnectFromServer();
+}
+
+void SearchClient::dispatch(const QJsonObject& reply) {
+    const int id = reply["id"].toInt();
+    if (m_pendingScans.remove(id))
+        emit scanFinished(reply["ok"].toBool(), reply["error"].toString());
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include <QObject>
+#include <QLocalSocket>
+#include <QSet>
+#include "searchprotocol.h"
+
+// тонкий клиент сервера поиска: запросы синхронные, как и локальный поиск в GUI;
+// ответы на асинхронные запросы (scanAsync) приходят сигналами
+class SearchClient : public QObject {
+    Q_OBJECT
+public:
+    explicit SearchClient(QObject* parent = nullptr);
+
+    // сначала пробует сокет владельца (все команды), затем общий (только поиск)
+    bool connectTo(const QString& name, int timeoutMs = 3000);
+    bool isConnected() const { return m_socket.state() == QLocalSocket::ConnectedState; }
+    bool isTrusted() const { return m_trusted; } // можно сканировать, очищать и обслуживать индекс
+
+    // rows заполняется при r.context == 0, windows — при r.context > 0
+    bool search(const SearchRequest& r, int& count,
+        QVector<SearchResult>& rows, QVector<SnippetWindow>& windows);
+    bool stats(CacheStats& out);
+    bool clearAll();
+    // полный проход обслуживания на сервере; на большом индексе идёт минуты
+    bool compact(MaintenanceReport& out);
+    // сканирование может идти долго: не ждём ответа, итог придёт в scanFinished
+    void scanAsync(const QString& dir);
+
+signals:
+    void scanFinished(bool ok, const QString& error);
+
+private slots:
+    void onReadyRead(); // ответы, пришедшие вне request()
+
+private:
+    QLocalSocket m_socket;
+    QByteArray m_buffer;
+    int m_nextId = 1;
+    bool m_trusted = false;
+    bool m_inRequest = false;  // request() сам вычитывает сокет
+    QSet<int> m_pendingScans;  // id ещё не завершённых сканирований
+
+    int post(QJsonObject msg); // отправляет запрос, возвращает его id
+    // ждёт ответ с данным id; ответы на другие (асинхронные) запросы пропускаются
+    bool request(QJsonObject msg, QJsonObject& reply, int timeoutMs = 60000);
+    bool waitReply(int id, QJsonObject& reply, int timeoutMs);
+    void dispatch(const QJsonObject& reply); // ответ на асинхронный запрос
+};
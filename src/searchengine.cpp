@@ -1,11 +1,67 @@
 #include "searchengine.h"
+#include "utils.h"
 #include <QSqlQuery>
 #include <QSqlError>
 #include <QFile>
-#include <QTextStream>
 #include <QRegularExpression>
 #include <QDateTime>
 #include <QDebug>
+#include <QSemaphore>
+#include <algorithm>
+#include <iterator>
+#include <limits>
+
+namespace {
+    // границы интервала дат в том же виде, что и Files.modified
+    QString lowerBound(const QDate& d) { return QDateTime(d, QTime(0, 0)).toString(Qt::ISODate); }
+    QString upperBound(const QDate& d) { return QDateTime(d, QTime(23, 59, 59)).toString(Qt::ISODate); }
+
+    bool resultLess(const SearchResult& a, const SearchResult& b) {
+        return a.file != b.file ? a.file < b.file : a.line < b.line;
+    }
+    bool windowLess(const SnippetWindow& a, const SnippetWindow& b) {
+        return a.file != b.file ? a.file < b.file : a.firstLine < b.firstLine;
+    }
+
+    // помечает совпадения шардом-источником
+    QVector<SearchResult> withShard(QVector<SearchResult> rows, const Shard& s) {
+        for (SearchResult& r : rows) r.shard = s.dbPath;
+        return rows;
+    }
+
+    // запускает fn на каждом шарде в пуле потоков чтения; каждый шард сортирует
+    // свою часть, здесь остаётся только слить упорядоченные списки.
+    // ждём семафором, а не QFuture::result(): тот может выполнить задачу из очереди
+    // в ждущем потоке, и её подключение осталось бы вне пула (см. ShardSet::releaseReaders)
+    template <typename T, typename Fn, typename Less>
+    QVector<T> fanOut(ShardSet* set, const QVector<Shard>& shards, Fn fn, Less less) {
+        QVector<QVector<T>> parts(shards.size()); // размер не меняется — указатели на части живы
+        QSemaphore done;
+        for (int i = 0; i < shards.size(); ++i) {
+            const Shard s = shards[i];
+            QVector<T>* part = &parts[i];
+            set->readerPool()->start([set, s, fn, less, part, &done]() {
+                // шард могли отключить после снимка shards(): не открываем (и не создаём) его файл
+                DBManager* db = set->isAttached(s.dbPath) ? DBManager::threadLocal(s.dbPath) : nullptr;
+                if (db) {
+                    *part = fn(db, s);
+                    std::sort(part->begin(), part->end(), less);
+                }
+                done.release();
+            });
+        }
+        done.acquire(shards.size());
+
+        QVector<T> out;
+        for (const QVector<T>& part : parts) {
+            QVector<T> merged; merged.reserve(out.size() + part.size());
+            std::merge(out.cbegin(), out.cend(), part.cbegin(), part.cend(),
+                std::back_inserter(merged), less);
+            out.swap(merged);
+        }
+        return out;
+    }
+}
 
 // маска
 QString SearchEngine::wildcardToLike(QString mask) {
@@ -15,68 +71,216 @@ QString SearchEngine::wildcardToLike(QString mask) {
     return mask;
 }
 
-// чтение конкретной строки файла
-QString SearchEngine::readLine(const QString& path, int lineNo) {
-    QFile f(path); 
-    if (!f.open(QIODevice::ReadOnly | QIODevice::Text)) return {};
-    QTextStream in(&f);
-    in.setCodec("UTF-8"); // кириллица/UTF-8
-    for (int i = 1; i < lineNo && !in.atEnd(); ++i) in.readLine(); // пролистываем N-1 строк
-    return in.atEnd() ? QString() : in.readLine(); // возвращаем нужную строку (или пусто)
+// маска -> регулярка (без учёта регистра, как LIKE)
+QRegularExpression SearchEngine::wildcardToRegex(const QString& mask) {
+    QString rx; rx.reserve(mask.size() * 2);
+    for (const QChar c : mask) {
+        if (c == '*') rx += ".*";
+        else if (c == '?') rx += '.';
+        else rx += QRegularExpression::escape(QString(c));
+    }
+    return QRegularExpression(QRegularExpression::anchoredPattern(rx),
+        QRegularExpression::CaseInsensitiveOption);
+}
+
+// чтение нескольких строк за один проход
+QHash<int, QString> SearchEngine::readLines(const QString& path, const QByteArray& codec,
+    const QVector<int>& lineNos)
+{
+    QHash<int, QString> out;
+    if (lineNos.isEmpty()) return out;
+    QFile f(path);
+    if (!f.open(QIODevice::ReadOnly)) return out;
+    LineReader in(&f, codec); // та же кодировка, что и при индексации
+
+    int lineNo = 0, idx = 0;
+    while (idx < lineNos.size() && !in.atEnd()) { // дальше последней нужной строки не читаем
+        ++lineNo;
+        if (lineNo != lineNos[idx]) { in.skipLine(); continue; } // ненужные строки не декодируем
+        out.insert(lineNo, in.readLine());
+        while (idx < lineNos.size() && lineNos[idx] <= lineNo) ++idx; // пропускаем дубли
+    }
+    return out;
+}
+
+int SearchEngine::truncateFrom(int size, int start, int length, int maxLength) {
+    if (maxLength <= 0 || size <= maxLength) return -1;
+    if (start < 0) { start = 0; length = 0; } // совпадения нет — берём начало
+
+    const int room = qMax(0, maxLength - length); // место под контекст слева и справа
+    return qMin(qMax(0, start - room / 2), size - maxLength);
+}
+
+// обрезка длинной строки вокруг совпадения
+QString SearchEngine::truncateAround(const QString& text, int start, int length, int maxLength) {
+    const int from = truncateFrom(text.size(), start, length, maxLength);
+    if (from < 0) return text;
+
+    QString out = text.mid(from, maxLength);
+    if (from > 0) out.prepend(QChar(0x2026)); // многоточие
+    if (from + maxLength < text.size()) out.append(QChar(0x2026));
+    return out;
+}
+
+// многомегабайтные строки не должны уходить дальше поиска (в GUI, в JSON сервера)
+void SearchEngine::truncateResult(SearchResult& r, int maxLength) {
+    const int from = truncateFrom(r.fragment.size(), r.matchStart, r.matchLength, maxLength);
+    if (from < 0) return;
+    r.fragment = truncateAround(r.fragment, r.matchStart, r.matchLength, maxLength);
+    r.fragmentOffset = from > 0 ? from - 1 : 0; // слева добавлено многоточие
+    if (r.matchStart >= 0) r.matchStart -= r.fragmentOffset;
 }
 
 // добавление фильтров к SQL
 void SearchEngine::appendFilters(QString& sql, const QString& alias,
-    const QString& mask, const QDate& from, const QDate& to)
+    const QString& mask, const QDate& from, const QDate& to, const TimeRange& time)
 {
     if (!mask.isEmpty()) sql += QString("AND %1.path LIKE :mask ESCAPE '\\' ").arg(alias); // фильтр по имени
     if (from.isValid())  sql += QString("AND %1.modified >= :from ").arg(alias); // фильтр "с даты"
     if (to.isValid())    sql += QString("AND %1.modified <= :to ").arg(alias); // фильтр "по дату"
+    // время записей: файлы без времени не отсекаем
+    if (time.from.isValid()) sql += QString("AND (%1.max_time IS NULL OR %1.max_time >= :tfrom) ").arg(alias);
+    if (time.to.isValid())   sql += QString("AND (%1.min_time IS NULL OR %1.min_time <= :tto) ").arg(alias);
 }
 
 // привязка значений фильтров
 void SearchEngine::bindFilters(QSqlQuery& q, const QString& mask,
-    const QDate& from, const QDate& to)
+    const QDate& from, const QDate& to, const TimeRange& time)
 {
     if (!mask.isEmpty()) q.bindValue(":mask", wildcardToLike(mask));
-    if (from.isValid())  q.bindValue(":from", QDateTime(from, QTime(0, 0)).toString(Qt::ISODate));
-    if (to.isValid())    q.bindValue(":to", QDateTime(to, QTime(23, 59, 59)).toString(Qt::ISODate));
+    if (from.isValid())  q.bindValue(":from", lowerBound(from));
+    if (to.isValid())    q.bindValue(":to", upperBound(to));
+    if (time.from.isValid()) q.bindValue(":tfrom", timeKey(time.from));
+    if (time.to.isValid())   q.bindValue(":tto", timeKey(time.to));
+}
+
+bool SearchEngine::passesFilters(const Posting& p, const QRegularExpression& maskRe,
+    const QDate& from, const QDate& to, const TimeRange& time)
+{
+    if (!maskRe.pattern().isEmpty() && !maskRe.match(p.path).hasMatch()) return false; // маска по пути
+    if (from.isValid() && p.modified < lowerBound(from)) return false; // ISO-строки сравниваются как даты
+    if (to.isValid() && p.modified > upperBound(to)) return false;
+    if (!p.minTime.isEmpty()) { // файл со временем записей — сверяем границы
+        if (time.from.isValid() && p.maxTime < timeKey(time.from)) return false;
+        if (time.to.isValid() && p.minTime > timeKey(time.to)) return false;
+    }
+    return true;
+}
+
+// диапазон строк по контрольным точкам (записи в логе идут по возрастанию времени)
+QPair<int, int> SearchEngine::lineRange(DBManager* db, int fileId, const TimeRange& time) {
+    QPair<int, int> range(1, std::numeric_limits<int>::max());
+    if (time.isNull()) return range;
+
+    QSqlQuery q(db->database());
+    q.prepare("SELECT line, ts FROM TimeCheckpoints WHERE file_id = :f ORDER BY line");
+    q.bindValue(":f", fileId);
+    if (!q.exec()) { qWarning() << q.lastError(); return range; }
+
+    const QString fromKey = time.from.isValid() ? timeKey(time.from) : QString();
+    const QString toKey = time.to.isValid() ? timeKey(time.to) : QString();
+    while (q.next()) {
+        const int line = q.value(0).toInt();
+        const QString ts = q.value(1).toString();
+        if (!fromKey.isEmpty() && ts < fromKey) range.first = line; // до этой точки всё раньше интервала
+        if (!toKey.isEmpty() && ts > toKey) { range.second = line - 1; break; } // дальше всё позже
+    }
+    return range;
+}
+
+PostingList SearchEngine::postingsFor(DBManager* db, int wordId) {
+    PostingList list;
+    const auto cache = db->cache();
+    if (cache && cache->postings(wordId, list)) return list; // попадание
+
+    const quint64 gen = cache ? cache->generation() : 0; // запоминаем до чтения из БД
+    QSqlQuery q(db->database());
+    q.prepare(
+        "SELECT f.id, f.path, f.modified, f.size, wi.line_numbers, f.min_time, f.max_time, f.codec "
+        "FROM WordIndex wi "
+        "JOIN Files f ON f.id = wi.file_id "
+        "WHERE wi.word_id = :id");
+    q.bindValue(":id", wordId);
+    if (!q.exec()) { qWarning() << q.lastError(); return list; }
+
+    while (q.next()) {
+        Posting p;
+        p.fileId = q.value(0).toInt();
+        p.path = q.value(1).toString();
+        p.modified = q.value(2).toString();
+        p.size = q.value(3).toLongLong();
+        p.minTime = q.value(5).toString();
+        p.maxTime = q.value(6).toString();
+        p.codec = q.value(7).toString().toLatin1();
+
+        const QStringList parts = q.value(4).toString().split(',', Qt::SkipEmptyParts); // разбираем номера один раз
+        p.lines.reserve(parts.size());
+        for (const QString& n : parts) p.lines.append(n.toInt());
+        list.append(p);
+    }
+    if (cache) cache->putPostings(wordId, list, gen);
+    return list;
+}
+
+QHash<int, QString> SearchEngine::fetchLines(DBManager* db, int fileId,
+    const QString& path, const QByteArray& codec, const QVector<int>& lineNos)
+{
+    QHash<int, QString> out;
+    const auto cache = fileId >= 0 ? db->cache() : QSharedPointer<SearchCache>();
+    QVector<int> missing;
+    for (const int n : lineNos) {
+        QString text;
+        if (cache && cache->fragment(fileId, n, text)) out.insert(n, text);
+        else missing.append(n);
+    }
+    if (missing.isEmpty()) return out;
+
+    const quint64 gen = cache ? cache->generation() : 0;
+    const QHash<int, QString> read = readLines(path, codec, missing); // один проход по файлу
+    for (auto it = read.cbegin(); it != read.cend(); ++it) { // строк за концом файла в ответе нет
+        out.insert(it.key(), it.value());
+        if (cache) cache->putFragment(fileId, it.key(), it.value(), gen);
+    }
+    return out;
 }
 
 // поиск по слову
 QVector<SearchResult> SearchEngine::searchWord(DBManager* db,
     const QString& query, bool caseSensitive,
-    const QString& fileMask, const QDate& from, const QDate& to)
+    const QString& fileMask, const QDate& from, const QDate& to, const TimeRange& time)
 {
     QVector<SearchResult> out; // собираем результаты
     if (!db || query.isEmpty()) return out; 
     const QString word = caseSensitive ? query : query.toLower(); // готовим слово с учётом регистра
-    QString sql = // присоединение по индексным таблицам
-        "SELECT f.path, f.modified, f.size, wi.line_numbers "
-        "FROM WordIndex wi "
-        "JOIN Words w ON w.id = wi.word_id "
-        "JOIN Files f ON f.id = wi.file_id "
-        "WHERE w.word = :word ";
-    appendFilters(sql, "f", fileMask, from, to);
+    const int wordId = db->findWord(word);
+    if (wordId < 0) return out; // такого слова нет в индексе
 
-    QSqlQuery q(db->database()); // готовим запрос
-    q.prepare(sql);
-    q.bindValue(":word", word); // привязка параметра :word
-    bindFilters(q, fileMask, from, to); // привязка :mask/:from/:to
-    if (!q.exec()) { qWarning() << q.lastError(); return out; } // если ошибка — отдаём пустой список
-
-    while (q.next()) { // идем по результатам
-        const QString path = q.value(0).toString(); // путь
-        const QString modified = q.value(1).toString(); // дата изменения 
-        const qint64  size = q.value(2).toLongLong(); // размер в байтах
-        const QString linesStr = q.value(3).toString(); // строка
-
-        const QStringList parts = linesStr.split(',', Qt::SkipEmptyParts); // разбиваем на номера
-        for (const QString& p : parts) { // для каждого номера строки
-            const int lineNo = p.toInt(); // переводим в int
-            const QString lineText = readLine(path, lineNo); // читаем конкретную строку
-            if (!lineText.isEmpty())
-                out.push_back({ path, lineNo, lineText, modified, size }); // добавляем результат
+    const QRegularExpression maskRe = fileMask.isEmpty() ? QRegularExpression() : wildcardToRegex(fileMask);
+    const PostingList postings = postingsFor(db, wordId); // фильтры применяем к закэшированному списку
+
+    const QRegularExpression wordRe( // границы слова — как при индексации
+        "(?<![\\p{L}\\d_])" + QRegularExpression::escape(word) + "(?![\\p{L}\\d_])",
+        QRegularExpression::UseUnicodePropertiesOption | QRegularExpression::CaseInsensitiveOption);
+
+    for (const Posting& p : postings) { // идем по файлам
+        if (!passesFilters(p, maskRe, from, to, time)) continue; // маска/даты/время
+        QVector<int> lines = p.lines;
+        if (!time.isNull() && !p.minTime.isEmpty()) { // до чтения файла сужаем до нужных строк
+            const QPair<int, int> range = lineRange(db, p.fileId, time);
+            lines.erase(std::remove_if(lines.begin(), lines.end(), [&range](int n) {
+                return n < range.first || n > range.second; }), lines.end());
+            if (lines.isEmpty()) continue;
+        }
+        const QHash<int, QString> texts = fetchLines(db, p.fileId, p.path, p.codec, lines); // все строки файла разом
+        for (const int lineNo : lines) { // для каждого номера строки
+            const QString lineText = texts.value(lineNo);
+            if (lineText.isEmpty()) continue;
+            const QRegularExpressionMatch m = wordRe.match(lineText); // где именно слово
+            SearchResult r{ p.path, lineNo, lineText, p.modified, p.size, p.fileId,
+                m.hasMatch() ? m.capturedStart() : -1, m.capturedLength() };
+            r.codec = p.codec;
+            truncateResult(r);
+            out.push_back(r); // добавляем результат
         }
     }
     return out;
@@ -85,17 +289,17 @@ QVector<SearchResult> SearchEngine::searchWord(DBManager* db,
 // поиск по регулярному выражению
 QVector<SearchResult> SearchEngine::searchRegex(DBManager* db,
     const QString& pattern, bool caseSensitive,
-    const QString& fileMask, const QDate& from, const QDate& to)
+    const QString& fileMask, const QDate& from, const QDate& to, const TimeRange& time)
 {
     QVector<SearchResult> out;
     if (!db || pattern.isEmpty()) return out; // без шаблона — нет поиска
 
-    QString sql = "SELECT path, modified, size FROM Files WHERE 1=1 "; // берём список файлов
-    appendFilters(sql, "Files", fileMask, from, to); // ограничиваем по маске/датам
+    QString sql = "SELECT id, path, modified, size, min_time, codec FROM Files WHERE 1=1 "; // берём список файлов
+    appendFilters(sql, "Files", fileMask, from, to, time); // ограничиваем по маске/датам/времени
 
     QSqlQuery q(db->database()); // запрос 
     q.prepare(sql);
-    bindFilters(q, fileMask, from, to); // привязываем параметры
+    bindFilters(q, fileMask, from, to, time); // привязываем параметры
     if (!q.exec()) { qWarning() << q.lastError(); return out; } // ошибка — пусто
 
     QRegularExpression::PatternOptions opts = QRegularExpression::UseUnicodePropertiesOption;
@@ -103,20 +307,141 @@ QVector<SearchResult> SearchEngine::searchRegex(DBManager* db,
     
     QRegularExpression re(pattern, opts); // компилируем паттерн
     while (q.next()) {
-        const QString path = q.value(0).toString();
-        const QString modified = q.value(1).toString();
-        const qint64  size = q.value(2).toLongLong();
+        const int     fileId = q.value(0).toInt();
+        const QString path = q.value(1).toString();
+        const QString modified = q.value(2).toString();
+        const qint64  size = q.value(3).toLongLong();
+        const bool    hasTime = !q.value(4).isNull();
+        const QByteArray codec = q.value(5).toString().toLatin1();
+        const QPair<int, int> range = lineRange(db, fileId, hasTime ? time : TimeRange()); // строки нужного интервала
+        if (range.first > range.second) continue;
 
         QFile f(path); // открываем файл
-        if (!f.open(QIODevice::ReadOnly | QIODevice::Text)) continue;
-        QTextStream in(&f); in.setCodec("UTF-8"); // кириллица/UTF-8
+        if (!f.open(QIODevice::ReadOnly)) continue;
+        LineReader in(&f, codec); // кодировка, определённая при индексации
 
         int lineNo = 0;
-        while (!in.atEnd()) { // читаем построчно
-            const QString line = in.readLine(); ++lineNo;
-            if (re.match(line).hasMatch()) // если паттерн нашёл совпадение
-                out.push_back({ path, lineNo, line, modified, size }); // добавляем результат
+        while (!in.atEnd() && lineNo < range.second) { // читаем построчно, дальше интервала не идём
+            ++lineNo;
+            if (lineNo < range.first) { in.skipLine(); continue; } // до интервала — без декодирования
+            const QString line = in.readLine();
+            const QRegularExpressionMatch m = re.match(line);
+            if (!m.hasMatch()) continue;
+            SearchResult r{ path, lineNo, line, modified, size, fileId,
+                m.capturedStart(), m.capturedLength() };
+            r.codec = codec;
+            truncateResult(r);
+            out.push_back(r); // добавляем результат
         }
     }
     return out;
 }
+
+// окна контекста вокруг совпадений
+QVector<SnippetWindow> SearchEngine::buildSnippets(DBManager* db,
+    const QVector<SearchResult>& hits, int context, int maxLineLength)
+{
+    QVector<SnippetWindow> out;
+    if (!db || hits.isEmpty()) return out;
+    context = qMax(0, context);
+
+    // группируем совпадения по файлам, сохраняя порядок появления файлов
+    QStringList order;
+    QHash<QString, QVector<const SearchResult*>> byFile;
+    for (const SearchResult& r : hits) {
+        auto& list = byFile[r.file];
+        if (list.isEmpty()) order << r.file;
+        list.append(&r);
+    }
+
+    for (const QString& path : order) {
+        QVector<const SearchResult*> fileHits = byFile.value(path);
+        std::sort(fileHits.begin(), fileHits.end(),
+            [](const SearchResult* a, const SearchResult* b) { return a->line < b->line; });
+        const SearchResult& head = *fileHits.first();
+
+        // сливаем пересекающиеся и соседние окна
+        QVector<SnippetWindow> windows;
+        QHash<int, const SearchResult*> hitAt; // строка -> первое совпадение в ней
+        for (const SearchResult* r : fileHits) {
+            if (hitAt.contains(r->line)) continue; // дубли одной строки
+            hitAt.insert(r->line, r);
+            const int first = qMax(1, r->line - context);
+            if (!windows.isEmpty() && first <= windows.last().lastLine + 1) {
+                windows.last().lastLine = r->line + context;
+            }
+            else {
+                SnippetWindow w;
+                w.file = path; w.firstLine = first; w.lastLine = r->line + context;
+                w.modified = head.modified; w.size = head.size;
+                windows.append(w);
+            }
+            windows.last().hitLines.append(r->line);
+        }
+
+        // все строки всех окон файла — одним проходом
+        QVector<int> needed;
+        for (const SnippetWindow& w : windows)
+            for (int n = w.firstLine; n <= w.lastLine; ++n) needed.append(n);
+        const QHash<int, QString> texts = fetchLines(db, head.fileId, path, head.codec, needed);
+
+        for (SnippetWindow& w : windows) {
+            int last = w.firstLine - 1;
+            for (int n = w.firstLine; n <= w.lastLine; ++n) {
+                if (!texts.contains(n)) break; // конец файла
+                const SearchResult* r = hitAt.value(n);
+                const int start = (r && r->matchStart >= 0) ? r->matchStart + r->fragmentOffset : -1; // в полной строке
+                w.lines << (r ? truncateAround(texts.value(n), start, r->matchLength, maxLineLength)
+                              : truncateAround(texts.value(n), -1, 0, maxLineLength));
+                last = n;
+            }
+            w.lastLine = last;
+            if (!w.lines.isEmpty()) out.append(w);
+        }
+    }
+    return out;
+}
+
+// поиск по слову во всех шардах
+QVector<SearchResult> SearchEngine::searchWord(ShardSet* shards,
+    const QString& query, bool caseSensitive,
+    const QString& fileMask, const QDate& from, const QDate& to, const TimeRange& time)
+{
+    if (!shards || query.isEmpty()) return {};
+    return fanOut<SearchResult>(shards, shards->shards(),
+        [=](DBManager* db, const Shard& s) {
+        return withShard(searchWord(db, query, caseSensitive, fileMask, from, to, time), s);
+    }, resultLess);
+}
+
+// поиск по регулярному выражению во всех шардах
+QVector<SearchResult> SearchEngine::searchRegex(ShardSet* shards,
+    const QString& pattern, bool caseSensitive,
+    const QString& fileMask, const QDate& from, const QDate& to, const TimeRange& time)
+{
+    if (!shards || pattern.isEmpty()) return {};
+    return fanOut<SearchResult>(shards, shards->shards(),
+        [=](DBManager* db, const Shard& s) {
+        return withShard(searchRegex(db, pattern, caseSensitive, fileMask, from, to, time), s);
+    }, resultLess);
+}
+
+// окна контекста: совпадения раздаются тем шардам, откуда они пришли
+// (fileId и кэш строк у каждого шарда свои)
+QVector<SnippetWindow> SearchEngine::buildSnippets(ShardSet* shards,
+    const QVector<SearchResult>& hits, int context, int maxLineLength)
+{
+    if (!shards || hits.isEmpty()) return {};
+    QHash<QString, QVector<SearchResult>> byShard; // путь к БД шарда -> совпадения
+    for (const SearchResult& r : hits)
+        byShard[r.shard.isEmpty() ? shards->shardFor(r.file).dbPath : r.shard].append(r);
+
+    QVector<Shard> involved; // шарды без совпадений не открываем
+    for (const Shard& s : shards->shards())
+        if (byShard.contains(s.dbPath)) involved.append(s);
+
+    return fanOut<SnippetWindow>(shards, involved,
+        [=](DBManager* db, const Shard& s) {
+        return buildSnippets(db, byShard.value(s.dbPath), context, maxLineLength);
+    }, windowLess);
+}
@@ -2,12 +2,34 @@
 #include <QVector>
 #include <QString>
 #include <QDate>
+#include <QHash>
+#include <QStringList>
+#include <QRegularExpression>
 #include "dbmanager.h"
+#include "shardset.h"
+#include "timeindex.h"
 
 struct SearchResult {
     QString file;
     int     line;
-    QString fragment;
+    QString fragment; // уже обрезан до kMaxLineLength вокруг совпадения
+    QString modified;
+    qint64  size = 0;
+    int     fileId = -1;
+    int     matchStart = -1; // позиция совпадения во fragment
+    int     matchLength = 0;
+    int     fragmentOffset = 0; // позиция fragment в исходной строке (matchStart + offset — в строке)
+    QByteArray codec; // кодировка файла для чтения контекста
+    QString shard;    // БД шарда, из которой пришло совпадение (fileId действителен только в ней)
+};
+
+// окно контекста вокруг одного или нескольких соседних совпадений
+struct SnippetWindow {
+    QString file;
+    int     firstLine = 0;
+    int     lastLine = 0;
+    QStringList  lines;    // строки firstLine..lastLine (уже обрезанные)
+    QVector<int> hitLines; // номера строк с совпадениями
     QString modified;
     qint64  size = 0;
 };
@@ -17,20 +39,74 @@ public:
     static QVector<SearchResult> searchWord(DBManager* db,
         const QString& query, bool caseSensitive,
         const QString& fileMask = QString(),
-        const QDate& from = QDate(), const QDate& to = QDate());
+        const QDate& from = QDate(), const QDate& to = QDate(),
+        const TimeRange& time = TimeRange());
 
     static QVector<SearchResult> searchRegex(DBManager* db,
         const QString& pattern, bool caseSensitive,
         const QString& fileMask = QString(),
-        const QDate& from = QDate(), const QDate& to = QDate());
+        const QDate& from = QDate(), const QDate& to = QDate(),
+        const TimeRange& time = TimeRange());
+
+    // то же по всем шардам: шарды опрашиваются параллельно,
+    // результаты сливаются в порядке (файл, строка)
+    static QVector<SearchResult> searchWord(ShardSet* shards,
+        const QString& query, bool caseSensitive,
+        const QString& fileMask = QString(),
+        const QDate& from = QDate(), const QDate& to = QDate(),
+        const TimeRange& time = TimeRange());
+
+    static QVector<SearchResult> searchRegex(ShardSet* shards,
+        const QString& pattern, bool caseSensitive,
+        const QString& fileMask = QString(),
+        const QDate& from = QDate(), const QDate& to = QDate(),
+        const TimeRange& time = TimeRange());
+
+    static QVector<SnippetWindow> buildSnippets(ShardSet* shards,
+        const QVector<SearchResult>& hits, int context,
+        int maxLineLength = kMaxLineLength);
+
+    // склеивает совпадения в окна по context строк до/после (как grep -C);
+    // строки каждого файла читаются за один проход
+    static QVector<SnippetWindow> buildSnippets(DBManager* db,
+        const QVector<SearchResult>& hits, int context,
+        int maxLineLength = kMaxLineLength);
+
+    // обрезает длинную строку до maxLength символов вокруг совпадения
+    static QString truncateAround(const QString& text, int start, int length,
+        int maxLength = kMaxLineLength);
+
+    static constexpr int kMaxLineLength = 400;
 
 private:
-    static QString readLine(const QString& path, int lineNo);
+    // начало вырезаемого куска строки; -1 — строка и так короткая
+    static int truncateFrom(int size, int start, int length, int maxLength);
+    // обрезает fragment совпадения и пересчитывает matchStart
+    static void truncateResult(SearchResult& r, int maxLength = kMaxLineLength);
+    // несколько строк файла за один проход (lineNos отсортированы по возрастанию)
+    static QHash<int, QString> readLines(const QString& path, const QByteArray& codec,
+        const QVector<int>& lineNos);
     static QString wildcardToLike(QString mask);
+    static QRegularExpression wildcardToRegex(const QString& mask);
+
+    // постинги слова: из кэша или из WordIndex с разбором line_numbers
+    static PostingList postingsFor(DBManager* db, int wordId);
+    // строки файла: из кэша фрагментов, недостающие — с диска за один проход
+    static QHash<int, QString> fetchLines(DBManager* db, int fileId,
+        const QString& path, const QByteArray& codec, const QVector<int>& lineNos);
+
+    // диапазон строк файла, где могут быть записи из интервала (по контрольным точкам);
+    // first > last — в файле нужного времени нет
+    static QPair<int, int> lineRange(DBManager* db, int fileId, const TimeRange& time);
 
     // небольшие общие хелперы для компактности:
     static void appendFilters(QString& sql, const QString& alias,
-        const QString& mask, const QDate& from, const QDate& to);
+        const QString& mask, const QDate& from, const QDate& to,
+        const TimeRange& time = TimeRange());
     static void bindFilters(QSqlQuery& q, const QString& mask,
-        const QDate& from, const QDate& to);
+        const QDate& from, const QDate& to,
+        const TimeRange& time = TimeRange());
+    // те же фильтры, но для постинга из кэша
+    static bool passesFilters(const Posting& p, const QRegularExpression& maskRe,
+        const QDate& from, const QDate& to, const TimeRange& time);
 };
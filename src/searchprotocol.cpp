@@ -0,0 +1,148 @@
+#include "searchprotocol.h"
+#include <QIODevice>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QtEndian>
+
+void SearchProtocol::writeFrame(QIODevice* dev, const QJsonObject& msg) {
+    const QByteArray body = QJsonDocument(msg).toJson(QJsonDocument::Compact);
+    uchar header[4];
+    qToBigEndian<quint32>(quint32(body.size()), header);
+    dev->write(reinterpret_cast<const char*>(header), sizeof(header));
+    dev->write(body);
+}
+
+bool SearchProtocol::takeFrame(QByteArray& buffer, QJsonObject& msg, bool& ok) {
+    ok = true;
+    if (buffer.size() < 4) return false;
+    const quint32 size = qFromBigEndian<quint32>(reinterpret_cast<const uchar*>(buffer.constData()));
+    if (size > kMaxFrameSize) { ok = false; return false; }
+    if (quint32(buffer.size()) - 4 < size) return false; // кадр пришёл не целиком
+
+    const QJsonDocument doc = QJsonDocument::fromJson(buffer.mid(4, int(size)));
+    buffer.remove(0, 4 + int(size));
+    msg = doc.object();
+    return true;
+}
+
+QJsonObject SearchProtocol::toJson(const SearchRequest& r) {
+    QJsonObject o;
+    o["query"] = r.query;
+    o["regex"] = r.regex;
+    o["case"] = r.caseSensitive;
+    o["mask"] = r.fileMask;
+    if (r.from.isValid()) o["from"] = r.from.toString(Qt::ISODate);
+    if (r.to.isValid()) o["to"] = r.to.toString(Qt::ISODate);
+    if (r.time.from.isValid()) o["timeFrom"] = r.time.from.toString(Qt::ISODate);
+    if (r.time.to.isValid()) o["timeTo"] = r.time.to.toString(Qt::ISODate);
+    o["context"] = r.context;
+    return o;
+}
+
+SearchRequest SearchProtocol::requestFromJson(const QJsonObject& o) {
+    SearchRequest r;
+    r.query = o["query"].toString();
+    r.regex = o["regex"].toBool();
+    r.caseSensitive = o["case"].toBool();
+    r.fileMask = o["mask"].toString();
+    r.from = QDate::fromString(o["from"].toString(), Qt::ISODate); // нет ключа — невалидная дата
+    r.to = QDate::fromString(o["to"].toString(), Qt::ISODate);
+    r.time.from = QDateTime::fromString(o["timeFrom"].toString(), Qt::ISODate);
+    r.time.to = QDateTime::fromString(o["timeTo"].toString(), Qt::ISODate);
+    r.context = o["context"].toInt();
+    return r;
+}
+
+QJsonObject SearchProtocol::toJson(const SearchResult& r) {
+    QJsonObject o;
+    o["file"] = r.file;
+    o["line"] = r.line;
+    o["fragment"] = r.fragment;
+    o["modified"] = r.modified;
+    o["size"] = double(r.size); // JSON-число: точно до 2^53
+    o["fileId"] = r.fileId;
+    o["matchStart"] = r.matchStart;
+    o["matchLength"] = r.matchLength;
+    o["fragmentOffset"] = r.fragmentOffset;
+    return o;
+}
+
+SearchResult SearchProtocol::resultFromJson(const QJsonObject& o) {
+    SearchResult r;
+    r.file = o["file"].toString();
+    r.line = o["line"].toInt();
+    r.fragment = o["fragment"].toString();
+    r.modified = o["modified"].toString();
+    r.size = qint64(o["size"].toDouble());
+    r.fileId = o["fileId"].toInt(-1);
+    r.matchStart = o["matchStart"].toInt(-1);
+    r.matchLength = o["matchLength"].toInt();
+    r.fragmentOffset = o["fragmentOffset"].toInt();
+    return r;
+}
+
+QJsonObject SearchProtocol::toJson(const SnippetWindow& w) {
+    QJsonObject o;
+    o["file"] = w.file;
+    o["firstLine"] = w.firstLine;
+    o["lastLine"] = w.lastLine;
+    o["lines"] = QJsonArray::fromStringList(w.lines);
+    QJsonArray hits;
+    for (const int n : w.hitLines) hits.append(n);
+    o["hitLines"] = hits;
+    o["modified"] = w.modified;
+    o["size"] = double(w.size);
+    return o;
+}
+
+SnippetWindow SearchProtocol::windowFromJson(const QJsonObject& o) {
+    SnippetWindow w;
+    w.file = o["file"].toString();
+    w.firstLine = o["firstLine"].toInt();
+    w.lastLine = o["lastLine"].toInt();
+    for (const QJsonValue& v : o["lines"].toArray()) w.lines << v.toString();
+    for (const QJsonValue& v : o["hitLines"].toArray()) w.hitLines << v.toInt();
+    w.modified = o["modified"].toString();
+    w.size = qint64(o["size"].toDouble());
+    return w;
+}
+
+QJsonObject SearchProtocol::toJson(const CacheStats& s) {
+    QJsonObject o;
+    o["postingHits"] = double(s.postingHits);
+    o["postingMisses"] = double(s.postingMisses);
+    o["fragmentHits"] = double(s.fragmentHits);
+    o["fragmentMisses"] = double(s.fragmentMisses);
+    return o;
+}
+
+CacheStats SearchProtocol::statsFromJson(const QJsonObject& o) {
+    CacheStats s;
+    s.postingHits = qint64(o["postingHits"].toDouble());
+    s.postingMisses = qint64(o["postingMisses"].toDouble());
+    s.fragmentHits = qint64(o["fragmentHits"].toDouble());
+    s.fragmentMisses = qint64(o["fragmentMisses"].toDouble());
+    return s;
+}
+
+QJsonObject SearchProtocol::toJson(const MaintenanceReport& r) {
+    QJsonObject o;
+    o["removedWords"] = r.removedWords;
+    o["repairedWords"] = r.repairedWords;
+    o["reclaimedBytes"] = double(r.reclaimedBytes);
+    o["sizeBytes"] = double(r.sizeBytes);
+    o["complete"] = r.complete;
+    o["needsConversion"] = r.needsConversion;
+    return o;
+}
+
+MaintenanceReport SearchProtocol::reportFromJson(const QJsonObject& o) {
+    MaintenanceReport r;
+    r.removedWords = o["removedWords"].toInt();
+    r.repairedWords = o["repairedWords"].toInt();
+    r.reclaimedBytes = qint64(o["reclaimedBytes"].toDouble());
+    r.sizeBytes = qint64(o["sizeBytes"].toDouble());
+    r.complete = o["complete"].toBool(true);
+    r.needsConversion = o["needsConversion"].toBool();
+    return r;
+}
@@ -0,0 +1,50 @@
+#pragma once
+#include <QByteArray>
+#include <QJsonObject>
+#include "searchengine.h"
+#include "indexmaintenance.h"
+
+class QIODevice;
+
+// параметры одного поиска (то, что GUI передаёт серверу)
+struct SearchRequest {
+    QString query;
+    bool    regex = false;
+    bool    caseSensitive = false;
+    QString fileMask;
+    QDate   from;
+    QDate   to;
+    TimeRange time;
+    int     context = 0; // > 0 — сервер сразу отдаёт окна контекста
+};
+
+// протокол локального сервера поиска: кадр = длина (quint32, big-endian) + JSON.
+// в каждом запросе есть "id" и "cmd", ответ несёт тот же "id" и "ok".
+// сокет name открыт всем пользователям машины, но только для search и stats;
+// scan, clear и compact принимаются лишь через adminName(name) — он доступен
+// только пользователю, под которым работает сервер
+class SearchProtocol {
+public:
+    static constexpr quint32 kMaxFrameSize = 256 * 1024 * 1024;
+
+    static QString adminName(const QString& name) { return name + QStringLiteral("-admin"); }
+
+    static void writeFrame(QIODevice* dev, const QJsonObject& msg);
+    // достаёт из буфера один целый кадр; false — кадр ещё не дочитан.
+    // ok = false, если длина кадра недопустима (соединение лучше закрыть)
+    static bool takeFrame(QByteArray& buffer, QJsonObject& msg, bool& ok);
+
+    static QJsonObject toJson(const SearchRequest& r);
+    static SearchRequest requestFromJson(const QJsonObject& o);
+
+    static QJsonObject toJson(const SearchResult& r);
+    static SearchResult resultFromJson(const QJsonObject& o);
+
+    static QJsonObject toJson(const SnippetWindow& w);
+    static SnippetWindow windowFromJson(const QJsonObject& o);
+
+    static QJsonObject toJson(const CacheStats& s);
+    static CacheStats statsFromJson(const QJsonObject& o);
+    static QJsonObject toJson(const MaintenanceReport& r);
+    static MaintenanceReport reportFromJson(const QJsonObject& o);
+};
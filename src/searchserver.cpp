@@ -0,0 +1,173 @@
+#include "searchserver.h"
+#include <QCoreApplication>
+#include <QDir>
+#include <QJsonArray>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QSettings>
+#include <QtConcurrent/QtConcurrentRun>
+#include <QDebug>
+
+SearchServer::SearchServer(QObject* parent) : QObject(parent) {}
+
+SearchServer::~SearchServer() {
+    m_queryPool.waitForDone(); // запросы в пуле обращаются к this
+    if (m_writer) {
+        m_writer->quit();
+        m_writer->wait();
+    }
+}
+
+bool SearchServer::start(const QString& name, const QString& indexDir, int queryThreads, int compactMinutes) {
+    if (!m_shards.open(indexDir)) return false;
+    m_queryPool.setMaxThreadCount(qMax(1, queryThreads));
+
+    // поток записи и индексатор — как в MainWindow
+    m_writer = new QThread(this);
+    m_indexer = new FileIndexer(&m_shards);
+    TimestampParser timeParser;
+    QSettings timeIni(QDir(QCoreApplication::applicationDirPath()).filePath("timestamps.ini"),
+        QSettings::IniFormat);
+    timeParser.loadPatterns(timeIni);
+    m_indexer->setTimestampParser(timeParser);
+    m_indexer->moveToThread(m_writer);
+    connect(m_writer, &QThread::finished, m_indexer, &QObject::deleteLater);
+    connect(m_indexer, &FileIndexer::scanFinished, this, &SearchServer::onScanFinished,
+        Qt::QueuedConnection);
+
+    // обслуживание не пересекается со сканом: очередь событий потока записи одна
+    m_maintenance = new IndexMaintenance(&m_shards);
+    m_maintenance->setSchedule(compactMinutes);
+    m_maintenance->moveToThread(m_writer);
+    connect(m_writer, &QThread::started, m_maintenance, &IndexMaintenance::startSchedule);
+    connect(m_writer, &QThread::finished, m_maintenance, &QObject::deleteLater);
+    m_writer->start();
+
+    // поиск в общем индексе — всем пользователям машины; менять индекс и читать
+    // чужие каталоги от имени сервера может только его владелец
+    m_server = new QLocalServer(this);
+    m_admin = new QLocalServer(this);
+    return listen(m_server, name, QLocalServer::WorldAccessOption)
+        && listen(m_admin, SearchProtocol::adminName(name), QLocalServer::UserAccessOption);
+}
+
+bool SearchServer::listen(QLocalServer* server, const QString& name, QLocalServer::SocketOptions options) {
+    server->setSocketOptions(options);
+    QLocalServer::removeServer(name); // сокет, оставшийся после аварийного завершения
+    if (!server->listen(name)) {
+        qWarning() << "Search server listen error:" << name << server->errorString();
+        return false;
+    }
+    connect(server, &QLocalServer::newConnection, this, &SearchServer::onNewConnection);
+    return true;
+}
+
+void SearchServer::onNewConnection() {
+    auto* server = qobject_cast<QLocalServer*>(sender());
+    if (!server) return;
+    while (QLocalSocket* socket = server->nextPendingConnection()) {
+        m_buffers.insert(socket, QByteArray());
+        if (server == m_admin) m_trusted.insert(socket);
+        connect(socket, &QLocalSocket::readyRead, this, &SearchServer::onReadyRead);
+        connect(socket, &QLocalSocket::disconnected, this, &SearchServer::onDisconnected);
+    }
+}
+
+void SearchServer::onReadyRead() {
+    auto* socket = qobject_cast<QLocalSocket*>(sender());
+    if (!socket) return;
+    QByteArray& buffer = m_buffers[socket];
+    buffer += socket->readAll();
+
+    QJsonObject msg;
+    bool ok = true;
+    while (SearchProtocol::takeFrame(buffer, msg, ok)) // в буфере может быть несколько кадров
+        handle(socket, msg);
+    if (!ok) socket->disconnectFromServer(); // мусор вместо длины кадра
+}
+
+void SearchServer::onDisconnected() {
+    auto* socket = qobject_cast<QLocalSocket*>(sender());
+    if (!socket) return;
+    m_buffers.remove(socket);
+    m_trusted.remove(socket);
+    socket->deleteLater();
+}
+
+void SearchServer::onScanFinished() {
+    if (m_pendingScans.isEmpty()) return;
+    const auto pending = m_pendingScans.dequeue(); // сканы идут в потоке записи по очереди
+    reply(pending.first, { { "id", pending.second }, { "ok", true } });
+}
+
+void SearchServer::handle(QLocalSocket* socket, const QJsonObject& msg) {
+    const QPointer<QLocalSocket> sock(socket);
+    const QJsonValue id = msg["id"];
+    const QString cmd = msg["cmd"].toString();
+
+    if (!m_trusted.contains(socket) && cmd != "search" && cmd != "stats") {
+        reply(sock, { { "id", id }, { "ok", false }, { "error", "command not permitted: " + cmd } });
+        return;
+    }
+
+    if (cmd == "search") { // поиск — в пуле, сокет не ждёт соседние запросы
+        const SearchRequest r = SearchProtocol::requestFromJson(msg);
+        QtConcurrent::run(&m_queryPool, [this, sock, id, r]() {
+            QJsonObject out = runSearch(r);
+            out["id"] = id;
+            reply(sock, out);
+        });
+    }
+    else if (cmd == "scan") { // ответ придёт по scanFinished
+        const QString dir = msg["dir"].toString();
+        m_pendingScans.enqueue({ sock, id });
+        QMetaObject::invokeMethod(m_indexer, [this, dir]() {
+            m_indexer->scanDirectory(dir, { "*.txt","*.log","*.csv" }); // кодировка — своя у каждого файла
+        }, Qt::QueuedConnection);
+    }
+    else if (cmd == "clear") { // очистка — в потоке записи, чтобы не пересечься со сканом
+        QMetaObject::invokeMethod(m_indexer, [this, sock, id]() {
+            reply(sock, { { "id", id }, { "ok", m_shards.clearAll() } });
+        }, Qt::QueuedConnection);
+    }
+    else if (cmd == "compact") { // по команде — без бюджета и с переводом старых БД
+        QMetaObject::invokeMethod(m_maintenance, [this, sock, id]() {
+            reply(sock, { { "id", id }, { "ok", true },
+                { "report", SearchProtocol::toJson(m_maintenance->run()) } });
+        }, Qt::QueuedConnection);
+    }
+    else if (cmd == "stats") {
+        reply(sock, { { "id", id }, { "ok", true },
+            { "cache", SearchProtocol::toJson(m_shards.cacheStats()) } });
+    }
+    else {
+        reply(sock, { { "id", id }, { "ok", false }, { "error", "unknown command: " + cmd } });
+    }
+}
+
+void SearchServer::reply(const QPointer<QLocalSocket>& socket, const QJsonObject& msg) {
+    // писать в сокет можно только из его потока
+    QMetaObject::invokeMethod(this, [socket, msg]() {
+        if (socket) SearchProtocol::writeFrame(socket, msg);
+    }, Qt::QueuedConnection);
+}
+
+QJsonObject SearchServer::runSearch(const SearchRequest& r) {
+    const QVector<SearchResult> rows = r.regex
+        ? SearchEngine::searchRegex(&m_shards, r.query, r.caseSensitive, r.fileMask, r.from, r.to, r.time)
+        : SearchEngine::searchWord(&m_shards, r.query, r.caseSensitive, r.fileMask, r.from, r.to, r.time);
+
+    QJsonObject out{ { "ok", true }, { "count", rows.size() } };
+    if (r.context > 0) { // окна строим здесь же — клиенту не нужно гонять совпадения обратно
+        QJsonArray windows;
+        for (const SnippetWindow& w : SearchEngine::buildSnippets(&m_shards, rows, r.context))
+            windows.append(SearchProtocol::toJson(w));
+        out["windows"] = windows;
+    }
+    else {
+        QJsonArray results;
+        for (const SearchResult& row : rows) results.append(SearchProtocol::toJson(row));
+        out["results"] = results;
+    }
+    return out;
+}
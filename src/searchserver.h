@@ -0,0 +1,56 @@
+#pragma once
+#include <QObject>
+#include <QHash>
+#include <QPair>
+#include <QPointer>
+#include <QQueue>
+#include <QSet>
+#include <QThread>
+#include <QThreadPool>
+#include <QLocalServer>
+#include "shardset.h"
+#include "fileindexer.h"
+#include "indexmaintenance.h"
+#include "searchprotocol.h"
+
+class QLocalSocket;
+
+// фоновый сервис: держит индекс, поток записи и тёплые кэши,
+// обслуживает поиск и индексацию по локальному сокету (см. SearchProtocol)
+class SearchServer : public QObject {
+    Q_OBJECT
+public:
+    explicit SearchServer(QObject* parent = nullptr);
+    ~SearchServer();
+
+    static QString defaultName() { return QStringLiteral("TextFileIndexer"); }
+
+    // открывает шарды и начинает слушать; queryThreads — число одновременных запросов,
+    // compactMinutes — период обслуживания индекса (0 — только по команде compact)
+    bool start(const QString& name = defaultName(), const QString& indexDir = "index",
+        int queryThreads = QThread::idealThreadCount(), int compactMinutes = 360);
+
+private slots:
+    void onNewConnection();
+    void onReadyRead();
+    void onDisconnected();
+    void onScanFinished();
+
+private:
+    ShardSet m_shards;
+    QLocalServer* m_server = nullptr; // только чтение, для всех пользователей
+    QLocalServer* m_admin = nullptr;  // все команды, только владелец процесса
+    QThread* m_writer = nullptr;     // поток индексации (один писатель)
+    FileIndexer* m_indexer = nullptr;
+    IndexMaintenance* m_maintenance = nullptr; // в том же потоке записи
+    QThreadPool m_queryPool;         // исполнитель поисковых запросов
+
+    QHash<QLocalSocket*, QByteArray> m_buffers; // недочитанные кадры
+    QSet<QLocalSocket*> m_trusted;              // пришли через m_admin
+    QQueue<QPair<QPointer<QLocalSocket>, QJsonValue>> m_pendingScans; // ждут scanFinished
+
+    bool listen(QLocalServer* server, const QString& name, QLocalServer::SocketOptions options);
+    void handle(QLocalSocket* socket, const QJsonObject& msg);
+    void reply(const QPointer<QLocalSocket>& socket, const QJsonObject& msg); // из любого потока
+    QJsonObject runSearch(const SearchRequest& r);
+};
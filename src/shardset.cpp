@@ -0,0 +1,177 @@
+#include "shardset.h"
+#include "dbmanager.h"
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QSettings>
+#include <QDebug>
+
+namespace {
+    // путь к директории в виде "c:/logs/" для сравнения префиксов
+    QString normalizedDir(const QString& dir) {
+        QString d = QDir::cleanPath(QDir::fromNativeSeparators(dir));
+        if (!d.endsWith('/')) d += '/';
+        return d;
+    }
+}
+
+ShardSet::ShardSet() {
+    m_readers.setExpiryTimeout(-1);
+}
+
+bool ShardSet::open(const QString& dirPath, int hashShards) {
+    QString dir = dirPath;
+    if (QFileInfo(dir).isRelative()) // как и index.db — рядом с исполняемым
+        dir = QDir(QCoreApplication::applicationDirPath()).filePath(dir);
+    if (!QDir().mkpath(dir)) { qWarning() << "Cannot create shard dir:" << dir; return false; }
+
+    QMutexLocker lock(&m_mutex);
+    m_dir = dir;
+    m_shards.clear();
+
+    QSettings ini(manifestPath(), QSettings::IniFormat); // манифест шардов
+    const int n = ini.beginReadArray("shards");
+    for (int i = 0; i < n; ++i) {
+        ini.setArrayIndex(i);
+        m_shards.append({ ini.value("name").toString(),
+            QDir(m_dir).absoluteFilePath(ini.value("path").toString()),
+            ini.value("root").toString() });
+    }
+    ini.endArray();
+    if (!m_shards.isEmpty()) return true;
+
+    // первый запуск: шарды по хэшу пути
+    for (int i = 0; i < qMax(1, hashShards); ++i) {
+        const QString name = QString("shard_%1").arg(i);
+        m_shards.append({ name, QDir(m_dir).absoluteFilePath(name + ".db"), QString() });
+    }
+    return saveManifest();
+}
+
+QVector<Shard> ShardSet::shards() const {
+    QMutexLocker lock(&m_mutex);
+    return m_shards;
+}
+
+bool ShardSet::isAttached(const QString& dbPath) const {
+    QMutexLocker lock(&m_mutex);
+    for (const Shard& s : m_shards)
+        if (s.dbPath == dbPath) return true;
+    return false;
+}
+
+Shard ShardSet::shardFor(const QString& filePath) const {
+    const QString path = QDir::cleanPath(QDir::fromNativeSeparators(filePath));
+    QMutexLocker lock(&m_mutex);
+
+    const Shard* best = nullptr; // самый длинный подходящий корень
+    QVector<const Shard*> hashed;
+    for (const Shard& s : m_shards) {
+        if (s.isHashShard()) { hashed.append(&s); continue; }
+        if (path.startsWith(s.root, Qt::CaseInsensitive) // пути в Windows без учёта регистра
+            && (!best || s.root.size() > best->root.size()))
+            best = &s;
+    }
+    if (best) return *best;
+    if (hashed.isEmpty()) return {};
+    return *hashed[pathHash(path) % quint32(hashed.size())];
+}
+
+bool ShardSet::attach(const QString& dbPath, const QString& root) {
+    if (root.isEmpty()) return false; // число шардов по хэшу не меняем — иначе сломается раскладка
+
+    QMutexLocker lock(&m_mutex);
+    const QString absPath = QDir(m_dir).absoluteFilePath(dbPath);
+    QString name = QFileInfo(absPath).completeBaseName();
+    for (const Shard& s : m_shards) {
+        if (s.dbPath == absPath) return false; // уже подключён
+        if (s.name == name) name += QString("_%1").arg(m_shards.size()); // имя должно быть уникальным
+    }
+    m_shards.append({ name, absPath, normalizedDir(root) });
+    return saveManifest();
+}
+
+bool ShardSet::detach(const QString& name, bool removeFile) {
+    Shard s;
+    {
+        QMutexLocker lock(&m_mutex);
+        int i = 0;
+        while (i < m_shards.size() && (m_shards[i].name != name || m_shards[i].isHashShard())) ++i;
+        if (i == m_shards.size()) return false;
+        s = m_shards.takeAt(i);
+        if (!saveManifest()) return false;
+    }
+    SearchCache::forDatabase(s.dbPath)->clear(); // кэш отключённой БД больше не нужен
+    releaseReaders(); // потоки поиска держат файл открытым
+
+    if (!removeFile) { // отключённый файл можно переносить: всё из WAL — в него самого
+        DBManager db;
+        if (db.open(s.dbPath)) db.leaveWal();
+        return true;
+    }
+    // старый -wal рядом с новым файлом того же имени был бы применён к нему
+    bool ok = true;
+    for (const QString& path : QStringList{ s.dbPath, s.dbPath + "-wal", s.dbPath + "-shm" }) {
+        if (QFile::exists(path) && !QFile::remove(path)) {
+            qWarning() << "Cannot remove shard file:" << path;
+            ok = false; // шард отключён, но файлы остались
+        }
+    }
+    return ok;
+}
+
+void ShardSet::releaseReaders() {
+    m_readers.waitForDone(); // в Qt 5 заодно завершает потоки пула
+}
+
+bool ShardSet::clearAll() {
+    bool ok = true;
+    for (const Shard& s : shards()) {
+        DBManager db;
+        ok = db.open(s.dbPath) && db.clearAll() && ok;
+    }
+    return ok;
+}
+
+CacheStats ShardSet::cacheStats() const {
+    CacheStats total;
+    for (const Shard& s : shards()) {
+        const CacheStats cs = SearchCache::forDatabase(s.dbPath)->stats();
+        total.postingHits += cs.postingHits;
+        total.postingMisses += cs.postingMisses;
+        total.fragmentHits += cs.fragmentHits;
+        total.fragmentMisses += cs.fragmentMisses;
+    }
+    return total;
+}
+
+QString ShardSet::manifestPath() const {
+    return QDir(m_dir).filePath("shards.ini");
+}
+
+bool ShardSet::saveManifest() const {
+    QSettings ini(manifestPath(), QSettings::IniFormat);
+    ini.remove("shards");
+    ini.beginWriteArray("shards", m_shards.size());
+    for (int i = 0; i < m_shards.size(); ++i) {
+        ini.setArrayIndex(i);
+        ini.setValue("name", m_shards[i].name);
+        ini.setValue("path", QDir(m_dir).relativeFilePath(m_shards[i].dbPath)); // каталог можно переносить
+        ini.setValue("root", m_shards[i].root);
+    }
+    ini.endArray();
+    ini.sync();
+    return ini.status() == QSettings::NoError;
+}
+
+// FNV-1a: раскладка не должна зависеть от запуска (qHash в Qt может иметь seed)
+quint32 ShardSet::pathHash(const QString& path) {
+    quint32 h = 2166136261u;
+    for (const QChar c : path.toLower()) {
+        h ^= c.unicode();
+        h *= 16777619u;
+    }
+    return h;
+}
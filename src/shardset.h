@@ -0,0 +1,59 @@
+#pragma once
+#include <QMutex>
+#include <QThreadPool>
+#include <QString>
+#include <QVector>
+#include "searchcache.h"
+
+// один шард индекса — отдельный файл SQLite
+struct Shard {
+    QString name;   // имя в манифесте
+    QString dbPath; // абсолютный путь к файлу БД
+    QString root;   // корневая директория; пусто — шард по хэшу пути
+
+    bool isValid() const { return !dbPath.isEmpty(); }
+    bool isHashShard() const { return root.isEmpty(); }
+};
+
+// набор шардов: файлы раскладываются по хэшу пути или по корневой директории.
+// поиск идёт в собственном пуле потоков, у каждого потока — свои подключения
+// к шардам (DBManager::threadLocal); писатели открывают подключения сами
+class ShardSet {
+public:
+    ShardSet();
+
+    // загружает манифест из dirPath (рядом с исполняемым, если путь относительный);
+    // при первом запуске создаёт hashShards шардов по хэшу
+    bool open(const QString& dirPath = "index", int hashShards = 4);
+
+    QVector<Shard> shards() const; // снимок текущего набора
+    bool isAttached(const QString& dbPath) const; // шард всё ещё в манифесте
+    QString dirPath() const { return m_dir; }
+
+    // шард, в который попадает файл: самый длинный подходящий root, иначе по хэшу
+    Shard shardFor(const QString& filePath) const;
+
+    // подключает готовую БД (например, архив старых логов) для файлов под root
+    bool attach(const QString& dbPath, const QString& root);
+    // отключает шард с корнем; файл БД (вместе с -wal и -shm) можно сразу удалить.
+    // false — шарда нет или его файлы удалить не удалось
+    bool detach(const QString& name, bool removeFile = false);
+
+    bool clearAll();
+    CacheStats cacheStats() const; // сумма по кэшам всех шардов
+
+    QThreadPool* readerPool() { return &m_readers; }
+    // дожидается запросов и завершает потоки чтения — с ними закрываются их подключения.
+    // поиск выполняется только в этих потоках (см. fanOut), поэтому других подключений нет
+    void releaseReaders();
+
+private:
+    QString manifestPath() const;
+    bool saveManifest() const;
+    static quint32 pathHash(const QString& path);
+
+    QString m_dir;
+    QVector<Shard> m_shards;
+    mutable QMutex m_mutex; // набор читают поток индексации и пул поиска
+    QThreadPool m_readers;  // потоки не истекают: подключения остаются тёплыми
+};
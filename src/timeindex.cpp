@@ -0,0 +1,82 @@
+#include "timeindex.h"
+#include <QLocale>
+#include <QSettings>
+#include <QStringList>
+#include <QDebug>
+
+QString timeKey(const QDateTime& t) {
+    return t.toString("yyyy-MM-ddTHH:mm:ss");
+}
+
+TimestampParser::TimestampParser() {
+    addPattern("^\\s*\\[?(\\d{4}-\\d{2}-\\d{2})[T ](\\d{2}:\\d{2}:\\d{2})", "yyyy-MM-dd HH:mm:ss"); // ISO-8601
+    addPattern("^\\s*\\[?(\\d{4}/\\d{2}/\\d{2}) (\\d{2}:\\d{2}:\\d{2})", "yyyy/MM/dd HH:mm:ss");
+    addPattern("^\\s*\\[?(\\d{2}\\.\\d{2}\\.\\d{4}) (\\d{2}:\\d{2}:\\d{2})", "dd.MM.yyyy HH:mm:ss");
+    addPattern("^([A-Z][a-z]{2}) +(\\d{1,2}) (\\d{2}:\\d{2}:\\d{2})", "MMM d HH:mm:ss"); // syslog, без года
+    for (Pattern& p : m_patterns) p.builtIn = true;
+}
+
+void TimestampParser::addPattern(const QString& regex, const QString& format) {
+    Pattern p;
+    p.re = QRegularExpression(regex);
+    if (!p.re.isValid()) { qWarning() << "Bad timestamp pattern:" << regex << p.re.errorString(); return; }
+    p.re.optimize(); // шаблон применяется к каждой строке
+    p.format = format;
+    p.hasYear = format.contains("yy");
+    m_patterns.append(p);
+}
+
+void TimestampParser::loadPatterns(QSettings& settings) {
+    const int n = settings.beginReadArray("timestamps");
+    for (int i = 0; i < n; ++i) {
+        settings.setArrayIndex(i);
+        addPattern(settings.value("regex").toString(), settings.value("format").toString());
+    }
+    settings.endArray();
+}
+
+// быстрый отсев для встроенных шаблонов: время начинается с цифры, '[' или названия месяца
+bool TimestampParser::mayStartBuiltIn(const QString& line) {
+    int i = 0;
+    while (i < line.size() && line[i].isSpace()) ++i;
+    if (i == line.size()) return false;
+    const QChar c = line[i];
+    return c.isDigit() || c == '[' || (c >= 'A' && c <= 'Z');
+}
+
+QDateTime TimestampParser::parse(const QString& line, int& hint, const QDate& reference) const {
+    if (line.isEmpty()) return {};
+    const bool builtInOk = mayStartBuiltIn(line); // свои шаблоны из timestamps.ini пробуем всегда
+
+    if (hint >= 0 && hint < m_patterns.size() && (builtInOk || !m_patterns[hint].builtIn)) {
+        const QDateTime t = tryPattern(m_patterns[hint], line, reference); // сначала шаблон, сработавший в прошлый раз
+        if (t.isValid()) return t;
+    }
+    for (int k = 0; k < m_patterns.size(); ++k) {
+        if (k == hint || (m_patterns[k].builtIn && !builtInOk)) continue;
+        const QDateTime t = tryPattern(m_patterns[k], line, reference);
+        if (t.isValid()) { hint = k; return t; }
+    }
+    return {};
+}
+
+QDateTime TimestampParser::tryPattern(const Pattern& p, const QString& line, const QDate& reference) {
+    const QRegularExpressionMatch m = p.re.match(line);
+    if (!m.hasMatch()) return {};
+
+    QStringList parts;
+    for (int g = 1; g <= m.lastCapturedIndex(); ++g) parts << m.captured(g);
+    QString text = parts.join(' ');
+    QString format = p.format;
+
+    const QDate ref = reference.isValid() ? reference : QDate::currentDate();
+    if (!p.hasYear) { // syslog: подставляем год файла
+        text = QString::number(ref.year()) + ' ' + text;
+        format = "yyyy " + format;
+    }
+
+    QDateTime t = QLocale::c().toDateTime(text, format); // имена месяцев — английские
+    if (t.isValid() && !p.hasYear && t.date() > ref.addDays(1))
+        t = t.addYears(-1); // запись из конца прошлого года
+    return t;
+}
@@ -0,0 +1,50 @@
+#pragma once
+#include <QDateTime>
+#include <QPair>
+#include <QRegularExpression>
+#include <QString>
+#include <QVector>
+
+class QSettings;
+
+// интервал времени записей (невалидная граница — без ограничения)
+struct TimeRange {
+    QDateTime from;
+    QDateTime to;
+
+    bool isNull() const { return !from.isValid() && !to.isValid(); }
+};
+
+// контрольная точка: номер строки и время записи в ней
+using TimeCheckpoint = QPair<int, QDateTime>;
+
+// время в виде текста для БД: сравнивается как строка
+QString timeKey(const QDateTime& t);
+
+// разбор времени в начале строки лога
+class TimestampParser {
+public:
+    TimestampParser(); // ISO-8601, syslog, dd.MM.yyyy, yyyy/MM/dd
+
+    // группы захвата склеиваются через пробел и разбираются форматом QDateTime;
+    // если в формате нет года, берётся год из reference
+    void addPattern(const QString& regex, const QString& format);
+    void clear() { m_patterns.clear(); }
+    // дополнительные шаблоны из массива "timestamps" (ключи regex и format)
+    void loadPatterns(QSettings& settings);
+
+    // hint — индекс последнего сработавшего шаблона: строки одного файла обычно однородны
+    QDateTime parse(const QString& line, int& hint, const QDate& reference = QDate()) const;
+
+private:
+    struct Pattern {
+        QRegularExpression re;
+        QString format;
+        bool hasYear = true;
+        bool builtIn = false; // встроенные начинаются с цифры, '[' или месяца — их можно отсеять заранее
+    };
+    QVector<Pattern> m_patterns;
+
+    static QDateTime tryPattern(const Pattern& p, const QString& line, const QDate& reference);
+    static bool mayStartBuiltIn(const QString& line);
+};
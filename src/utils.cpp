@@ -0,0 +1,131 @@
+#include "utils.h"
+#include <QIODevice>
+#include <QTextCodec>
+#include <QTextStream>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define TFI_HAVE_SSE2 1
+#endif
+
+namespace {
+    QByteArray chopEol(QByteArray raw) {
+        while (raw.endsWith('\n') || raw.endsWith('\r')) raw.chop(1);
+        return raw;
+    }
+
+    // UTF-16 без BOM: нулевые байты почти всегда стоят на одной чётности
+    QByteArray guessUtf16(const QByteArray& head) {
+        int zeroEven = 0, zeroOdd = 0;
+        const int n = head.size() & ~1;
+        for (int i = 0; i < n; i += 2) {
+            if (head[i] == 0) ++zeroEven;
+            if (head[i + 1] == 0) ++zeroOdd;
+        }
+        const int pairs = n / 2;
+        if (pairs == 0) return {};
+        if (zeroOdd * 4 > pairs && zeroEven * 20 < pairs) return "UTF-16LE";
+        if (zeroEven * 4 > pairs && zeroOdd * 20 < pairs) return "UTF-16BE";
+        return {};
+    }
+
+    // частые строчные буквы (о е а и н т с) в windows-1251 и KOI8-R
+    QByteArray guessCyrillic(const QByteArray& head) {
+        static const uchar cp1251[] = { 0xEE, 0xE5, 0xE0, 0xE8, 0xED, 0xF2, 0xF1 };
+        static const uchar koi8r[] = { 0xCF, 0xC5, 0xC1, 0xC9, 0xCE, 0xD4, 0xD3 };
+        int counts[256] = {};
+        for (const char c : head) ++counts[uchar(c)];
+
+        int score1251 = 0, scoreKoi = 0;
+        for (const uchar b : cp1251) score1251 += counts[b];
+        for (const uchar b : koi8r) scoreKoi += counts[b];
+        if (score1251 == 0 && scoreKoi == 0) return {};
+        return score1251 >= scoreKoi ? QByteArray("windows-1251") : QByteArray("KOI8-R");
+    }
+}
+
+QByteArray detectCodec(const QByteArray& head, const QByteArray& fallback) {
+    if (head.startsWith("\xEF\xBB\xBF")) return "UTF-8"; // BOM
+    if (head.startsWith("\xFF\xFE")) return "UTF-16LE";
+    if (head.startsWith("\xFE\xFF")) return "UTF-16BE";
+
+    const QByteArray utf16 = guessUtf16(head);
+    if (!utf16.isEmpty()) return utf16;
+
+    // блок мог оборваться посреди символа, если файл длиннее блока
+    if (isValidUtf8(head.constData(), head.size(), head.size() >= kCodecDetectChunk)) return "UTF-8";
+
+    const QByteArray cyr = guessCyrillic(head);
+    return cyr.isEmpty() ? fallback : cyr;
+}
+
+bool isValidUtf8(const char* data, int size, bool allowTruncatedTail) {
+    const uchar* p = reinterpret_cast<const uchar*>(data);
+    const uchar* end = p + size;
+
+    while (p < end) {
+#ifdef TFI_HAVE_SSE2
+        // 16 байт ASCII за раз: старший бит ни у одного не выставлен
+        while (end - p >= 16
+            && _mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p))) == 0)
+            p += 16;
+        if (p == end) break;
+#endif
+        const uchar c = *p;
+        if (c < 0x80) { ++p; continue; }
+
+        int need = 0;             // байтов продолжения
+        uchar lo = 0x80, hi = 0xBF; // допустимый диапазон второго байта
+        if (c >= 0xC2 && c <= 0xDF) need = 1;
+        else if (c == 0xE0) { need = 2; lo = 0xA0; }             // без overlong
+        else if (c == 0xED) { need = 2; hi = 0x9F; }             // без суррогатов
+        else if (c >= 0xE1 && c <= 0xEF) need = 2;
+        else if (c == 0xF0) { need = 3; lo = 0x90; }
+        else if (c >= 0xF1 && c <= 0xF3) need = 3;
+        else if (c == 0xF4) { need = 3; hi = 0x8F; }             // не выше U+10FFFF
+        else return false;
+
+        if (end - p <= need) { // последовательность не влезла в буфер
+            if (!allowTruncatedTail) return false;
+            for (const uchar* q = p + 1; q < end; ++q) {
+                const uchar lo2 = (q == p + 1) ? lo : 0x80, hi2 = (q == p + 1) ? hi : 0xBF;
+                if (*q < lo2 || *q > hi2) return false;
+            }
+            return true;
+        }
+        if (p[1] < lo || p[1] > hi) return false;
+        for (int k = 2; k <= need; ++k)
+            if ((p[k] & 0xC0) != 0x80) return false;
+        p += need + 1;
+    }
+    return true;
+}
+
+LineReader::LineReader(QIODevice* dev, const QByteArray& codec) : m_dev(dev) {
+    if (codec.startsWith("UTF-16")) {
+        m_stream.reset(new QTextStream(dev));
+        m_stream->setCodec(codec.constData());
+        return;
+    }
+    if (!codec.isEmpty() && codec != "UTF-8")
+        m_codec = QTextCodec::codecForName(codec); // неизвестное имя — читаем как UTF-8
+    if (!m_codec && m_dev->peek(3) == "\xEF\xBB\xBF")
+        m_dev->read(3); // BOM не часть первой строки
+}
+
+LineReader::~LineReader() = default;
+
+bool LineReader::atEnd() const {
+    return m_stream ? m_stream->atEnd() : m_dev->atEnd();
+}
+
+QString LineReader::readLine() {
+    if (m_stream) return m_stream->readLine();
+    const QByteArray raw = chopEol(m_dev->readLine());
+    return m_codec ? m_codec->toUnicode(raw) : QString::fromUtf8(raw);
+}
+
+void LineReader::skipLine() {
+    if (m_stream) m_stream->readLine();
+    else m_dev->readLine(); // без декодирования
+}
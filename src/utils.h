@@ -1 +1,37 @@
 #pragma once
+#include <QByteArray>
+#include <QString>
+#include <memory>
+
+class QIODevice;
+class QTextCodec;
+class QTextStream;
+
+// сколько байт начала файла смотрим при определении кодировки
+const int kCodecDetectChunk = 64 * 1024;
+
+// кодировка по началу файла: BOM, затем проверка UTF-8, затем частотная
+// оценка windows-1251 / KOI8-R. Возвращает имя для QTextCodec или fallback
+QByteArray detectCodec(const QByteArray& head, const QByteArray& fallback = "UTF-8");
+
+// корректный ли UTF-8 (ASCII-блоки проверяются SSE2);
+// allowTruncatedTail — буфер обрезан посреди последнего символа
+bool isValidUtf8(const char* data, int size, bool allowTruncatedTail = false);
+
+// построчное чтение в заданной кодировке. UTF-8 и однобайтовые кодировки
+// читаются сырыми строками: ненужные строки не декодируются вовсе,
+// а UTF-8 идёт напрямую через QString::fromUtf8 без QTextCodec
+class LineReader {
+public:
+    LineReader(QIODevice* dev, const QByteArray& codec); // пустой codec — UTF-8
+    ~LineReader();
+
+    bool atEnd() const;
+    QString readLine();
+    void skipLine();
+
+private:
+    QIODevice* m_dev;
+    QTextCodec* m_codec = nullptr;         // nullptr — быстрый путь UTF-8
+    std::unique_ptr<QTextStream> m_stream; // только UTF-16: перевод строки не однобайтовый
+};